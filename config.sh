@@ -15,5 +15,19 @@ if "$PYTHON" -c 'import sys; sys.exit(sys.version_info[0] == 3)' ; then
     echo 'error: need Python 3.x' 1>&2
     exit 1
 fi
+# Options handled here, and removed before the rest are passed on:
+#   --enable-alloc-tracking  Count allocations, for the debug.allocs cvar
+for arg in "$@" ; do
+    shift
+    case "$arg" in
+        --enable-alloc-tracking)
+            CPPFLAGS="${CPPFLAGS:+$CPPFLAGS }-DLD_ALLOC_TRACKING"
+            export CPPFLAGS
+            ;;
+        *)
+            set -- "$@" "$arg"
+            ;;
+    esac
+done
 srcdir=`dirname "$0"`
 exec "$PYTHON" "$srcdir/sglib/script/config.py" config "$srcdir/project.xml" "$@"
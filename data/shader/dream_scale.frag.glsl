@@ -0,0 +1,49 @@
+#version 120
+
+// The dream composite and the pattern scale in a single pass, used
+// when nothing is drawn between them.  Each screen pixel evaluates
+// the composite at the center of its composite texel, so the result
+// matches the separate dream and scale passes.
+
+uniform sampler2D u_reality;
+uniform sampler2D u_background;
+uniform sampler2D u_pattern;
+
+// u_world, u_blendcolor, u_blendscale, u_noisescale, u_noiseoffset,
+// u_backgroundxform, and u_pixscale are in the frame block.
+
+varying vec2 v_texcoord;
+
+#include "noise"
+
+const vec4 weight = vec4(0.2989, 0.5870, 0.1140, 0.0);
+
+void main() {
+    vec2 texcoord = (floor(v_texcoord * u_pixscale) + 0.5) / u_pixscale;
+
+    vec2 noisecoord = texcoord * u_noisescale;
+    vec2 distort = vec2(
+        NOISE_X(noisecoord + u_noiseoffset.xy),
+        NOISE_Y(noisecoord + u_noiseoffset.zw));
+    distort *= u_world * 0.02;
+
+    vec4 reality = texture2D(u_reality, texcoord + distort);
+
+    vec2 delta = (texcoord - u_blendscale.xy) * u_blendscale.zw;
+    float d = dot(delta, delta);
+    vec4 color = u_blendcolor * d * d;
+
+    vec4 toned = reality * (1.0 - color.a) + color * reality.a;
+    float value = dot(reality, weight);
+    vec4 monochrome = vec4(vec3(value), reality.a);
+
+    vec4 background = texture2D(
+        u_background,
+        (texcoord + u_backgroundxform.xy) * u_backgroundxform.zw);
+    vec4 foreground = mix(toned, monochrome, u_world);
+    vec4 picture = background * vec4(1.0 - foreground.a) + foreground;
+
+    vec4 pattern = texture2D(u_pattern, v_texcoord * u_pixscale * 0.125);
+    pattern *= texture2D(u_pattern, v_texcoord * u_pixscale * 0.0625);
+    gl_FragColor = picture * pattern;
+}
@@ -0,0 +1,64 @@
+// Noise for the dream distortion, included by the dream and
+// dream_scale fragment shaders.  Defines NOISE_X(coord) and
+// NOISE_Y(coord), which give noise in the range [-0.5, 0.5] at noise
+// texture coordinates.
+
+// NOISE_QUALITY selects the noise: 0 samples the noise texture, 1
+// and 2 compute value noise with one or two octaves.
+#ifndef NOISE_QUALITY
+#define NOISE_QUALITY 0
+#endif
+
+#if NOISE_QUALITY > 0
+
+// Hash-based value noise on a lattice of composite pixels.  The
+// lattice wraps every NOISE_PERIOD pixels, the size of the noise
+// texture, so offsets wrap seamlessly.  NOISE_PERIOD is defined by
+// the graphics system.
+const float noise_period = float(NOISE_PERIOD);
+
+float hash(vec2 p) {
+    vec3 p3 = fract(vec3(p.xyx) * 0.1031);
+    p3 += dot(p3, p3.yzx + 33.33);
+    return fract((p3.x + p3.y) * p3.z);
+}
+
+float value_noise(vec2 p, float period) {
+    vec2 i = floor(p);
+    vec2 f = p - i;
+#if NOISE_QUALITY > 1
+    vec2 u = f * f * f * (f * (f * 6.0 - 15.0) + 10.0);
+#else
+    vec2 u = f * f * (3.0 - 2.0 * f);
+#endif
+    vec2 i0 = mod(i, period);
+    vec2 i1 = mod(i + 1.0, period);
+    float a = hash(i0);
+    float b = hash(vec2(i1.x, i0.y));
+    float c = hash(vec2(i0.x, i1.y));
+    float d = hash(i1);
+    return mix(mix(a, b, u.x), mix(c, d, u.x), u.y);
+}
+
+// Noise in the range [-0.5, 0.5], at noise texture coordinates.
+float noise(vec2 coord) {
+    vec2 p = coord * noise_period;
+#if NOISE_QUALITY > 1
+    return value_noise(p, noise_period) * 0.6667 +
+        value_noise(p * 2.0, noise_period * 2.0) * 0.3333 - 0.5;
+#else
+    return value_noise(p, noise_period) - 0.5;
+#endif
+}
+
+#define NOISE_X(coord) noise(coord)
+#define NOISE_Y(coord) noise((coord) + vec2(0.37, 0.71))
+
+#else
+
+uniform sampler2D u_noise;
+
+#define NOISE_X(coord) (texture2D(u_noise, coord).r - 0.5)
+#define NOISE_Y(coord) (texture2D(u_noise, coord).g - 0.5)
+
+#endif
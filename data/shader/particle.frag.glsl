@@ -0,0 +1,9 @@
+#version 120
+
+// The color is premultiplied.  Zero alpha makes the particle additive.
+uniform vec4 u_color;
+varying float v_alpha;
+
+void main() {
+    gl_FragColor = u_color * v_alpha;
+}
@@ -0,0 +1,14 @@
+#version 120
+
+// Each particle is a square.  The corner is per-vertex, and the
+// particle (x, y, alpha, size) is per-instance.
+attribute vec2 a_corner;
+attribute vec4 a_particle;
+uniform vec4 u_vertxform;
+varying float v_alpha;
+
+void main() {
+    vec2 pos = a_particle.xy + (a_corner - 0.5) * a_particle.w;
+    v_alpha = a_particle.z * (1.0 / 255.0);
+    gl_Position = vec4(pos * u_vertxform.xy + u_vertxform.zw, 0.0, 1.0);
+}
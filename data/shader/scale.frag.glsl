@@ -2,7 +2,7 @@
 
 uniform sampler2D u_picture;
 uniform sampler2D u_pattern;
-uniform vec2 u_pixscale;
+// u_pixscale is in the frame block.
 varying vec2 v_texcoord;
 
 void main() {
@@ -0,0 +1,8 @@
+#version 120
+
+uniform sampler2D u_picture;
+varying vec2 v_texcoord;
+
+void main() {
+    gl_FragColor = texture2D(u_picture, v_texcoord);
+}
@@ -0,0 +1,17 @@
+#version 120
+
+// Sharp bilinear: nearest neighbor inside each texel, with a linear
+// blend one screen pixel wide at the texel edges.  The picture must
+// use linear filtering.
+
+uniform sampler2D u_picture;
+// u_pixscale and u_scale are in the frame block.
+varying vec2 v_texcoord;
+
+void main() {
+    vec2 texel = v_texcoord * u_pixscale;
+    vec2 center = fract(texel) - 0.5;
+    vec2 range = 0.5 - 0.5 / u_scale;
+    vec2 f = (center - clamp(center, -range, range)) * u_scale + 0.5;
+    gl_FragColor = texture2D(u_picture, (floor(texel) + f) / u_pixscale);
+}
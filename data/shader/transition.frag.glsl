@@ -1,13 +1,21 @@
 #version 120
 
-uniform sampler2D u_picture1;
-uniform sampler2D u_picture2;
+// Diamond wipe from the previous scene, drawn over the new scene.
+// The new scene shows through inside the diamond, which grows from
+// the center as u_time goes from 0 to 1.
+
+uniform sampler2D u_picture;
 uniform vec2 u_center;
 uniform float u_time;
 uniform float u_maxradius;
+// u_pixscale is in the frame block.
 varying vec2 v_texcoord;
 
 void main()
 {
-	float dist = dot(abs(u_texcoord - u_center), vec2(1.0, 1.0));
+    vec2 delta = abs(v_texcoord - u_center) * u_pixscale;
+    float dist = delta.x + delta.y;
+    if (dist < u_time * u_maxradius)
+        discard;
+    gl_FragColor = texture2D(u_picture, v_texcoord);
 }
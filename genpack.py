@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+# Copyright 2014 Dietrich Epp.
+import os
+import struct
+import sys
+os.chdir(os.path.dirname(os.path.realpath(__file__)))
+
+# Must match the reader in src/base/archive.cpp.
+PACK = 'data.pack'
+PACK_MAGIC = b'DLPK'
+PACK_VERSION = 1
+HEADER_SIZE = 16
+ENTRY_SIZE = 16
+ALIGNMENT = 16
+
+# Audio is streamed by the mixer from loose files, so it is not packed.
+EXCLUDE_EXTENSIONS = {'.opus'}
+
+def scan(root):
+    """Get the paths of all files to pack, relative to the root."""
+    paths = []
+    for dirpath, dirnames, filenames in os.walk(root):
+        dirnames[:] = [d for d in dirnames if not d.startswith('.')]
+        for fname in filenames:
+            if fname.startswith('.'):
+                continue
+            if os.path.splitext(fname)[1] in EXCLUDE_EXTENSIONS:
+                continue
+            path = os.path.relpath(os.path.join(dirpath, fname), root)
+            paths.append(path.replace(os.path.sep, '/'))
+    # The reader uses a binary search, so sort by bytes.
+    paths.sort(key=lambda path: path.encode('UTF-8'))
+    return paths
+
+def align(offset):
+    return (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1)
+
+def run():
+    paths = scan('data')
+    names = [path.encode('UTF-8') for path in paths]
+    name_offset = HEADER_SIZE + ENTRY_SIZE * len(paths)
+    offset = align(name_offset + sum(len(name) for name in names))
+    entries = []
+    contents = []
+    for path, name in zip(paths, names):
+        with open(os.path.join('data', path), 'rb') as fp:
+            data = fp.read()
+        entries.append((name_offset, len(name), offset, len(data)))
+        contents.append((offset, data))
+        name_offset += len(name)
+        offset = align(offset + len(data))
+    with open(PACK + '.tmp', 'wb') as fp:
+        fp.write(struct.pack('<4sIII', PACK_MAGIC, PACK_VERSION,
+                             len(paths), 0))
+        for entry in entries:
+            fp.write(struct.pack('<IIII', *entry))
+        for name in names:
+            fp.write(name)
+        for offset, data in contents:
+            fp.write(b'\0' * (offset - fp.tell()))
+            fp.write(data)
+    os.replace(PACK + '.tmp', PACK)
+    print('packed {} files into {}, {} bytes'
+          .format(len(paths), PACK, offset))
+
+run()
@@ -1,12 +1,22 @@
 #!/usr/bin/env python3
 # Copyright 2014 Dietrich Epp.
 import os
+import struct
 import subprocess
 import collections
+import sys
+import tempfile
 os.chdir(os.path.dirname(os.path.realpath(__file__)))
 Image = collections.namedtuple('Image', 'name width height')
+Location = collections.namedtuple('Location', 'x y page rotated')
 AUTOGEN = '// This file is automatically generated.'
 
+# Baked atlas, must match the loader in src/base/sprite_sheet.cpp.
+ATLAS = 'data/atlas/sprite'
+ATLAS_MAGIC = b'DLSA'
+ATLAS_VERSION = 1
+MAX_PAGE_SIZE = 512
+
 def program_exists(name):
     """Determine whether a program exists in the search path."""
     for path in os.environ['PATH'].split(os.path.pathsep):
@@ -47,6 +57,153 @@ def scan(root):
     images.sort(key=lambda x: x.name)
     return images
 
+def fnv1a(data, h=0x811c9dc5):
+    for b in data:
+        h = ((h ^ b) * 0x01000193) & 0xffffffff
+    return h
+
+class MaxRects(object):
+    """MaxRects packer, the same algorithm as src/base/pack.cpp."""
+    def __init__(self, width, height):
+        self.width = width
+        self.height = height
+        self.free = [(0, 0, width, height)]
+
+    def find(self, w, h):
+        best = None
+        for fx, fy, fw, fh in self.free:
+            for rot in (False, True):
+                rw, rh = (h, w) if rot else (w, h)
+                if rw > fw or rh > fh:
+                    continue
+                dx, dy = fw - rw, fh - rh
+                score = (min(dx, dy), max(dx, dy))
+                if best is None or score < best[0]:
+                    best = score, fx, fy, rot
+        return best and best[1:]
+
+    def place(self, x, y, w, h):
+        newfree = []
+        for f in self.free:
+            fx, fy, fw, fh = f
+            if x >= fx + fw or x + w <= fx or y >= fy + fh or y + h <= fy:
+                newfree.append(f)
+                continue
+            if x > fx:
+                newfree.append((fx, fy, x - fx, fh))
+            if x + w < fx + fw:
+                newfree.append((x + w, fy, fx + fw - x - w, fh))
+            if y > fy:
+                newfree.append((fx, fy, fw, y - fy))
+            if y + h < fy + fh:
+                newfree.append((fx, y + h, fw, fy + fh - y - h))
+        def contains(a, b):
+            return (b[0] >= a[0] and b[1] >= a[1] and
+                    b[0] + b[2] <= a[0] + a[2] and b[1] + b[3] <= a[1] + a[3])
+        self.free = [f for i, f in enumerate(newfree)
+                     if not any(contains(g, f) and (g != f or j < i)
+                                for j, g in enumerate(newfree) if j != i)]
+
+def try_pack(images, order, width, height, require_all):
+    packer = MaxRects(width, height)
+    placed = {}
+    for i in order:
+        w, h = images[i].width, images[i].height
+        r = packer.find(w, h)
+        if r is None:
+            if require_all:
+                return None
+            continue
+        x, y, rot = r
+        packer.place(x, y, *((h, w) if rot else (w, h)))
+        placed[i] = x, y, rot
+    return placed
+
+def pack(images):
+    """Pack images into pages, returning (pages, locations)."""
+    for image in images:
+        if image.width > MAX_PAGE_SIZE or image.height > MAX_PAGE_SIZE:
+            raise Exception('image too large: {}'.format(image.name))
+    order = sorted(range(len(images)),
+                   key=lambda i: (-max(images[i].width, images[i].height),
+                                  -images[i].width * images[i].height))
+    sizes = []
+    size = 16
+    while size <= MAX_PAGE_SIZE:
+        sizes.append(size)
+        size *= 2
+    pages = []
+    locations = [None] * len(images)
+    while order:
+        area = sum(images[i].width * images[i].height for i in order)
+        best = None
+        for height in sizes:
+            for width in sizes:
+                if width * height < area:
+                    continue
+                if try_pack(images, order, width, height, True) is None:
+                    continue
+                key = width * height, abs(width - height)
+                if best is None or key < best[0]:
+                    best = key, width, height
+                break
+        if best is None:
+            width = height = MAX_PAGE_SIZE
+        else:
+            width, height = best[1:]
+        placed = try_pack(images, order, width, height, False)
+        for i, (x, y, rot) in placed.items():
+            locations[i] = Location(x, y, len(pages), rot)
+        pages.append((width, height))
+        order = [i for i in order if i not in placed]
+    return pages, locations
+
+def bake(categories, allimages):
+    """Bake the sprite atlas pages and rectangle table."""
+    if not program_exists('gm'):
+        print('warning: gm not found, not baking sprite atlas',
+              file=sys.stderr)
+        return
+    images = []
+    for (category, enum), catimages in zip(categories, allimages):
+        for image in catimages:
+            images.append(image._replace(
+                name='{}/{}'.format(category, image.name)))
+    pages, locations = pack(images)
+    os.makedirs(os.path.dirname(ATLAS), exist_ok=True)
+    with tempfile.TemporaryDirectory() as tmpdir:
+        for pagenum, (width, height) in enumerate(pages):
+            cmd = ['gm', 'convert', '-size', '{}x{}'.format(width, height),
+                   'xc:transparent']
+            for i, (image, loc) in enumerate(zip(images, locations)):
+                if loc.page != pagenum:
+                    continue
+                path = os.path.join('data', image.name + '.png')
+                if loc.rotated:
+                    tpath = os.path.join(tmpdir, '{}.png'.format(i))
+                    subprocess.check_call(
+                        ['gm', 'convert', path, '-transpose', tpath])
+                    path = tpath
+                cmd.extend(['-draw', "image Over {},{} 0,0 '{}'"
+                            .format(loc.x, loc.y, path)])
+            cmd.append('{}.{}.png'.format(ATLAS, pagenum))
+            subprocess.check_call(cmd)
+    names = b''.join(image.name.encode('ASCII') + b'\0' for image in images)
+    with open(ATLAS + '.dat', 'wb') as fp:
+        fp.write(struct.pack('<4sIIII', ATLAS_MAGIC, ATLAS_VERSION,
+                             len(images), len(pages), fnv1a(names)))
+        for width, height in pages:
+            fp.write(struct.pack('<HH', width, height))
+        for image, loc in zip(images, locations):
+            fp.write(struct.pack('<hhhhhhBB', loc.x, loc.y,
+                                 image.width, image.height,
+                                 image.width//2, image.height//2,
+                                 loc.page, int(loc.rotated)))
+    area = sum(w * h for w, h in pages)
+    used = sum(image.width * image.height for image in images)
+    print('baked {} sprites into {} pages, {:.1f}% occupied'
+          .format(len(images), len(pages), 100.0 * used / area))
+
 def run():
     categories = [('sprite', 'Sprite'), ('tile', 'Tile')]
     allimages = [scan(c[0]) for c in categories]
@@ -68,5 +225,7 @@ def run():
                       .format(category, image.name,
                               image.width, image.height,
                               image.width//2, image.height//2), file=fp)
+    if '--no-bake' not in sys.argv[1:]:
+        bake(categories, allimages)
 
 run()
@@ -0,0 +1,149 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "alloc.hpp"
+#include "cvar.hpp"
+#include "log.hpp"
+#include <cstdlib>
+#include <new>
+#include <string>
+namespace Base {
+
+namespace {
+
+enum class Mode { OFF, WARN, ABORT };
+
+// Trivial type, so it needs no thread-local initialization, and can
+// be used from operator new on any thread.
+thread_local AllocStats thread_alloc;
+
+Mode check_mode() {
+    static const Mode mode = [] {
+        std::string value = CVar::get_string("debug", "allocs", "off");
+        if (value == "warn")
+            return Mode::WARN;
+        if (value == "abort")
+            return Mode::ABORT;
+        if (value != "off")
+            Log::warn("invalid value for debug.allocs: %s", value.c_str());
+        return Mode::OFF;
+    }();
+    return mode;
+}
+
+}
+
+#if defined LD_ALLOC_TRACKING
+
+bool Alloc::available() {
+    return true;
+}
+
+AllocStats Alloc::thread_stats() {
+    return thread_alloc;
+}
+
+#else
+
+bool Alloc::available() {
+    return false;
+}
+
+AllocStats Alloc::thread_stats() {
+    AllocStats r = { 0, 0 };
+    return r;
+}
+
+#endif
+
+AllocCheck::AllocCheck(const char *name, int warmup)
+    : m_name(name), m_warmup(warmup), m_remaining(warmup) {
+    m_start.count = m_start.bytes = 0;
+    m_last = m_start;
+}
+
+void AllocCheck::reset() {
+    m_remaining = m_warmup;
+}
+
+void AllocCheck::begin() {
+    m_start = Alloc::thread_stats();
+}
+
+void AllocCheck::end() {
+    m_last = Alloc::thread_stats() - m_start;
+    if (m_remaining > 0) {
+        m_remaining--;
+        return;
+    }
+    if (!m_last.count)
+        return;
+    switch (check_mode()) {
+    case Mode::OFF:
+        break;
+    case Mode::WARN:
+        Log::warn("%s: %llu allocations (%llu bytes) in steady state",
+                  m_name, m_last.count, m_last.bytes);
+        // Warn once per warmup period, so the log stays readable.
+        m_remaining = m_warmup;
+        break;
+    case Mode::ABORT:
+        Log::abort("%s: %llu allocations (%llu bytes) in steady state",
+                   m_name, m_last.count, m_last.bytes);
+        break;
+    }
+}
+
+}
+
+#if defined LD_ALLOC_TRACKING
+
+namespace {
+
+void *tracked_alloc(std::size_t size) {
+    Base::thread_alloc.count++;
+    Base::thread_alloc.bytes += size;
+    return std::malloc(size ? size : 1);
+}
+
+}
+
+void *operator new(std::size_t size) {
+    void *ptr = tracked_alloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](std::size_t size) {
+    void *ptr = tracked_alloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return tracked_alloc(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return tracked_alloc(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+#endif
@@ -0,0 +1,60 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_BASE_ALLOC_HPP
+#define LD_BASE_ALLOC_HPP
+namespace Base {
+
+/// Allocation counters.
+struct AllocStats {
+    /// Number of allocations.
+    unsigned long long count;
+    /// Number of bytes allocated.
+    unsigned long long bytes;
+
+    AllocStats operator-(const AllocStats &other) const {
+        AllocStats r = { count - other.count, bytes - other.bytes };
+        return r;
+    }
+};
+
+/// Allocation tracking.  Tracking replaces the global operator new,
+/// and is only compiled in when LD_ALLOC_TRACKING is defined, which
+/// is done by running config.sh with --enable-alloc-tracking.
+/// Otherwise, all counters read as zero.
+struct Alloc {
+    /// Determine whether allocation tracking is compiled in.
+    static bool available();
+    /// Get the total allocations made by the current thread.
+    static AllocStats thread_stats();
+};
+
+/// Check that a repeated operation, such as a tick or a frame, does
+/// not allocate once it reaches a steady state.  Configured by the
+/// debug.allocs cvar, which is "off", "warn", or "abort".
+class AllocCheck {
+private:
+    const char *m_name;
+    int m_warmup;
+    int m_remaining;
+    AllocStats m_start;
+    AllocStats m_last;
+
+public:
+    /// Create a check for an operation with the given name.  The
+    /// first few repetitions are allowed to allocate.
+    AllocCheck(const char *name, int warmup);
+
+    /// Allow the operation to allocate again while it warms up, for
+    /// example, after loading a new level.
+    void reset();
+    /// Mark the start of the operation.
+    void begin();
+    /// Mark the end of the operation, and check its allocations.
+    void end();
+    /// Get the allocations made by the last operation.
+    AllocStats last() const { return m_last; }
+};
+
+}
+#endif
@@ -0,0 +1,181 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "archive.hpp"
+#include "cvar.hpp"
+#include "log.hpp"
+#include <cstring>
+
+#if defined _WIN32
+# define WIN32_LEAN_AND_MEAN 1
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace Base {
+
+namespace {
+
+// The archive format must match genpack.py.  All fields are 32-bit
+// little-endian.  The header is the magic, version, entry count, and a
+// reserved field.  It is followed by the table of contents, sorted by
+// name, with the name offset, name length, data offset, and data
+// length of each file.  Then come the names and the file contents,
+// and file contents are aligned to ALIGNMENT bytes.
+const char MAGIC[4] = { 'D', 'L', 'P', 'K' };
+const unsigned VERSION = 1;
+const std::size_t HEADER_SIZE = 16, ENTRY_SIZE = 16, ALIGNMENT = 16;
+
+unsigned read_u32(const unsigned char *p) {
+    return static_cast<unsigned>(p[0]) |
+        (static_cast<unsigned>(p[1]) << 8) |
+        (static_cast<unsigned>(p[2]) << 16) |
+        (static_cast<unsigned>(p[3]) << 24);
+}
+
+struct Map {
+    const unsigned char *data;
+    std::size_t size;
+    // Number of entries in the table of contents.
+    std::size_t count;
+};
+
+// Map a file into memory.  Returns false if the file does not exist.
+bool map_file(const std::string &path, Map &map) {
+#if defined _WIN32
+    HANDLE file = CreateFileA(
+        path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(
+        file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping)
+        return false;
+    void *ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!ptr)
+        return false;
+    map.data = static_cast<const unsigned char *>(ptr);
+    map.size = static_cast<std::size_t>(size.QuadPart);
+    return true;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void *ptr = mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                     PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+        return false;
+    map.data = static_cast<const unsigned char *>(ptr);
+    map.size = static_cast<std::size_t>(st.st_size);
+    return true;
+#endif
+}
+
+// Check that the archive's table of contents is valid.
+bool check_archive(const Map &map) {
+    const unsigned char *p = map.data;
+    if (map.size < HEADER_SIZE || std::memcmp(p, MAGIC, 4) ||
+        read_u32(p + 4) != VERSION)
+        return false;
+    std::size_t count = read_u32(p + 8);
+    if (count > (map.size - HEADER_SIZE) / ENTRY_SIZE)
+        return false;
+    for (std::size_t i = 0; i < count; i++) {
+        const unsigned char *e = p + HEADER_SIZE + i * ENTRY_SIZE;
+        std::size_t name_off = read_u32(e), name_len = read_u32(e + 4);
+        std::size_t data_off = read_u32(e + 8), data_len = read_u32(e + 12);
+        if (name_off > map.size || name_len > map.size - name_off ||
+            data_off > map.size || data_len > map.size - data_off ||
+            data_off % ALIGNMENT != 0)
+            return false;
+    }
+    return true;
+}
+
+Map open_archive() {
+    Map map = { nullptr, 0, 0 };
+    if (CVar::get_bool("debug", "hotreload", false))
+        return map;
+    std::string path = CVar::get_string("path", "pack", "data.pack");
+    if (path.empty() || !map_file(path, map)) {
+        Log::info("%s: no archive, using loose files", path.c_str());
+        return map;
+    }
+    if (!check_archive(map))
+        Log::abort("%s: invalid archive", path.c_str());
+    map.count = read_u32(map.data + 8);
+    Log::info("%s: %zu files", path.c_str(), map.count);
+    return map;
+}
+
+const Map &get_archive() {
+    static const Map map = open_archive();
+    return map;
+}
+
+}
+
+bool Archive::find(const std::string &path,
+                   const void **ptr, std::size_t *size) {
+    const Map &map = get_archive();
+    std::size_t lo = 0, hi = map.count;
+    while (lo < hi) {
+        std::size_t mid = lo + (hi - lo) / 2;
+        const unsigned char *e = map.data + HEADER_SIZE + mid * ENTRY_SIZE;
+        std::size_t name_len = read_u32(e + 4);
+        std::size_t n = name_len < path.size() ? name_len : path.size();
+        int c = std::memcmp(map.data + read_u32(e), path.data(), n);
+        if (c == 0)
+            c = name_len < path.size() ? -1 : name_len > path.size();
+        if (c < 0) {
+            lo = mid + 1;
+        } else if (c > 0) {
+            hi = mid;
+        } else {
+            *ptr = map.data + read_u32(e + 8);
+            *size = read_u32(e + 12);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Archive::find(const std::string &path, const char *extensions,
+                   const void **ptr, std::size_t *size) {
+    if (!extensions)
+        return find(path, ptr, size);
+    std::string epath;
+    const char *p = extensions;
+    while (true) {
+        const char *sep = std::strchr(p, ':');
+        std::size_t len = sep ? sep - p : std::strlen(p);
+        epath = path;
+        epath += '.';
+        epath.append(p, len);
+        if (find(epath, ptr, size))
+            return true;
+        if (!sep)
+            return false;
+        p = sep + 1;
+    }
+}
+
+}
@@ -0,0 +1,30 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_BASE_ARCHIVE_HPP
+#define LD_BASE_ARCHIVE_HPP
+#include <cstddef>
+#include <string>
+namespace Base {
+
+/// A read-only archive of data files, created by genpack.py.  The
+/// archive is mapped into memory the first time it is used, and stays
+/// mapped until the program exits, so file contents can be used
+/// without copying.
+///
+/// The archive is named by the path.pack cvar.  It is not used if
+/// debug.hotreload is set, so edits to loose files take effect.
+struct Archive {
+    /// Find a file in the archive.  Returns false if the file is not
+    /// in the archive or there is no archive.
+    static bool find(const std::string &path,
+                     const void **ptr, std::size_t *size);
+
+    /// Find a file in the archive, trying each extension in a
+    /// colon-separated list.
+    static bool find(const std::string &path, const char *extensions,
+                     const void **ptr, std::size_t *size);
+};
+
+}
+#endif
@@ -8,8 +8,25 @@
 #include <limits>
 #include <new>
 #include <cstdlib>
+#include <cstring>
 namespace Base {
 
+/// Hash the contents of an array, to detect unchanged data.
+inline unsigned long long array_hash(const void *ptr, std::size_t size) {
+    const unsigned char *p = static_cast<const unsigned char *>(ptr);
+    unsigned long long hash = 14695981039346656037ull;
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        unsigned long long word;
+        std::memcpy(&word, p + i, 8);
+        hash = (hash ^ word) * 1099511628211ull;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    return hash;
+}
+
 // OpenGL attribute array data types.
 template<typename T>
 struct ArrayType { };
@@ -71,6 +88,9 @@ private:
     unsigned m_alloc;
     bool m_dirty;
     GLuint m_buffer;
+    // Size and hash of the data in the buffer.
+    unsigned m_uploaded;
+    unsigned long long m_hash;
 
 public:
     explicit Array();
@@ -90,25 +110,31 @@ public:
     void reserve(std::size_t total);
     /// Insert the given number of elements and return a pointer to the first.
     T *insert(std::size_t count);
-    /// Upload the array to an OpenGL buffer.
+    /// Upload the array to an OpenGL buffer.  Nothing is uploaded if
+    /// the contents are the same as the last upload.
     void upload(GLenum usage);
-    /// Set the array as a vertex attribute.
-    void set_attrib(GLint attrib);
+    /// Set the array as a vertex attribute, starting at the given
+    /// element.
+    void set_attrib(GLint attrib, unsigned first = 0);
 };
 
 template<class T>
 inline Array<T>::Array()
-    : m_data(nullptr), m_count(0), m_alloc(0), m_dirty(true), m_buffer(0)
+    : m_data(nullptr), m_count(0), m_alloc(0), m_dirty(true), m_buffer(0),
+      m_uploaded(0), m_hash(0)
 { }
 
 template<class T>
 inline Array<T>::Array(Array<T> &&other)
-    : m_data(nullptr), m_count(0), m_alloc(0), m_dirty(true), m_buffer(0) {
+    : m_data(nullptr), m_count(0), m_alloc(0), m_dirty(true), m_buffer(0),
+      m_uploaded(0), m_hash(0) {
     m_data = other.m_data;
     m_count = other.m_count;
     m_alloc = other.m_alloc;
     m_dirty = other.m_dirty;
     m_buffer = other.m_buffer;
+    m_uploaded = other.m_uploaded;
+    m_hash = other.m_hash;
     other.m_data = nullptr;
     other.m_count = 0;
     other.m_alloc = 0;
@@ -127,11 +153,14 @@ Array<T> &Array<T>::operator=(Array<T> &&other) {
     if (this == &other)
         return *this;
     std::free(m_data);
+    glDeleteBuffers(1, &m_buffer);
     m_data = other.m_data;
     m_count = other.m_count;
     m_alloc = other.m_alloc;
-    m_dirty=  other.m_dirty;
+    m_dirty = other.m_dirty;
     m_buffer = other.m_buffer;
+    m_uploaded = other.m_uploaded;
+    m_hash = other.m_hash;
     other.m_data = nullptr;
     other.m_count = 0;
     other.m_alloc = 0;
@@ -153,6 +182,7 @@ bool Array<T>::empty() const {
 template<class T>
 void Array<T>::clear() {
     m_count = 0;
+    m_dirty = true;
 }
 
 template<class T>
@@ -195,6 +225,13 @@ template<class T>
 void Array<T>::upload(GLenum usage) {
     if (!m_dirty)
         return;
+    m_dirty = false;
+    // Most layers are rebuilt every frame with the same contents.
+    unsigned long long hash = array_hash(m_data, m_count * sizeof(T));
+    if (m_buffer != 0 && m_count == m_uploaded && hash == m_hash)
+        return;
+    m_uploaded = m_count;
+    m_hash = hash;
     if (m_buffer == 0)
         glGenBuffers(1, &m_buffer);
     glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
@@ -203,11 +240,11 @@ void Array<T>::upload(GLenum usage) {
 }
 
 template<class T>
-void Array<T>::set_attrib(GLint attrib) {
+void Array<T>::set_attrib(GLint attrib, unsigned first) {
     glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
     glVertexAttribPointer(
         attrib, ArrayType<T>::SIZE, ArrayType<T>::TYPE,
-        GL_FALSE, 0, 0);
+        GL_FALSE, 0, reinterpret_cast<const void *>(sizeof(T) * first));
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
@@ -0,0 +1,122 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "asset.hpp"
+#include "clock.hpp"
+#include "image.hpp"
+#include "ktx.hpp"
+#include "log.hpp"
+#include "task.hpp"
+#include "thread.hpp"
+#include <vector>
+namespace Base {
+
+namespace {
+
+// A texture decoded on a worker thread, waiting to be uploaded.
+struct TextureJob {
+    Texture *dest;
+    std::string path;
+    KTXImage ktx;
+    Image image;
+    bool compressed;
+};
+
+}
+
+struct AssetLoader::Data {
+    const char *m_name;
+    TaskPool m_pool;
+    long long m_start;
+    Mutex m_lock;
+    // Total time spent by tasks, in microseconds.
+    long long m_task_time;
+    int m_count;
+    std::vector<std::unique_ptr<TextureJob>> m_texture;
+    std::vector<std::function<void()>> m_process;
+    std::vector<std::function<void()>> m_upload;
+
+    explicit Data(const char *name)
+        : m_name(name), m_pool(TaskPool::default_threads()),
+          m_start(Clock::micros()), m_task_time(0), m_count(0) { }
+
+    void add(std::function<void()> func);
+};
+
+void AssetLoader::Data::add(std::function<void()> func) {
+    m_count++;
+    m_pool.add([this, func]() {
+        long long t0 = Clock::micros();
+        func();
+        long long t = Clock::micros() - t0;
+        Lock lock(m_lock);
+        m_task_time += t;
+    });
+}
+
+AssetLoader::AssetLoader(const char *name)
+    : m_data(new Data(name))
+{ }
+
+AssetLoader::~AssetLoader()
+{ }
+
+void AssetLoader::image(Image *dest, const std::string &path) {
+    m_data->add([dest, path]() { dest->load(path); });
+}
+
+void AssetLoader::texture(Texture *dest, const std::string &path) {
+    std::unique_ptr<TextureJob> job(new TextureJob);
+    job->dest = dest;
+    job->path = path;
+    job->compressed = false;
+    TextureJob *jp = job.get();
+    m_data->m_texture.push_back(std::move(job));
+    // Same search order as Texture::load(path).
+    m_data->add([jp]() {
+        jp->compressed = jp->ktx.load(jp->path + ".ktx");
+        if (!jp->compressed)
+            jp->image.load(jp->path);
+    });
+}
+
+void AssetLoader::process(std::function<void()> func) {
+    m_data->m_process.push_back(std::move(func));
+}
+
+void AssetLoader::upload(std::function<void()> func) {
+    m_data->m_upload.push_back(std::move(func));
+}
+
+void AssetLoader::finish() {
+    auto &d = *m_data;
+    d.m_pool.wait();
+    long long t_decode = Clock::micros();
+    for (auto &func : d.m_process)
+        d.add(func);
+    d.m_pool.wait();
+    long long t_process = Clock::micros();
+    for (auto &job : d.m_texture) {
+        if (job->compressed)
+            *job->dest = Texture::load(job->ktx);
+        else
+            *job->dest = Texture::load(job->image);
+    }
+    for (auto &func : d.m_upload)
+        func();
+    long long t_upload = Clock::micros();
+
+    Log::info("%s: %d tasks on %d threads, "
+              "decode %.1f ms, process %.1f ms, upload %.1f ms, "
+              "task total %.1f ms",
+              d.m_name, d.m_count, d.m_pool.threads() + 1,
+              (t_decode - d.m_start) * 1e-3,
+              (t_process - t_decode) * 1e-3,
+              (t_upload - t_process) * 1e-3,
+              d.m_task_time * 1e-3);
+    d.m_texture.clear();
+    d.m_process.clear();
+    d.m_upload.clear();
+}
+
+}
@@ -0,0 +1,43 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_BASE_ASSET_HPP
+#define LD_BASE_ASSET_HPP
+#include <functional>
+#include <memory>
+#include <string>
+namespace Base {
+class Image;
+struct Texture;
+
+/// Loads a batch of assets in parallel.  Files are read and decoded
+/// on worker threads as soon as they are added.  OpenGL objects are
+/// only created on the thread which calls finish().
+class AssetLoader {
+    struct Data;
+    std::unique_ptr<Data> m_data;
+
+public:
+    /// Create a loader for the named batch of assets.
+    explicit AssetLoader(const char *name);
+    AssetLoader(const AssetLoader &) = delete;
+    ~AssetLoader();
+    AssetLoader &operator=(const AssetLoader &) = delete;
+
+    /// Decode an image.  The image is valid in process and upload
+    /// functions.
+    void image(Image *dest, const std::string &path);
+    /// Load a texture.  The texture is valid after finish() returns.
+    void texture(Texture *dest, const std::string &path);
+    /// Run a function on a worker thread after all images are decoded.
+    void process(std::function<void()> func);
+    /// Run a function on the calling thread during finish(), after
+    /// processing is complete.
+    void upload(std::function<void()> func);
+    /// Wait for decoding and processing, create OpenGL objects, and
+    /// log how long each stage took.
+    void finish();
+};
+
+}
+#endif
@@ -0,0 +1,19 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_BASE_CLOCK_HPP
+#define LD_BASE_CLOCK_HPP
+#include <chrono>
+namespace Base {
+
+/// High-resolution monotonic clock, for measuring performance.
+struct Clock {
+    /// Get the current time in microseconds, from an arbitrary epoch.
+    static long long micros() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+}
+#endif
@@ -0,0 +1,49 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "cvar.hpp"
+#include "log.hpp"
+#include "sg/cvar.h"
+#include <cstdlib>
+#include <cstring>
+namespace Base {
+
+std::string CVar::get_string(const char *section, const char *name,
+                             const char *defval) {
+    const char *value;
+    if (!sg_cvar_gets(section, name, &value))
+        return defval;
+    return value;
+}
+
+bool CVar::get_bool(const char *section, const char *name, bool defval) {
+    static const char *const TRUE_NAMES[] = { "yes", "true", "on", "1" };
+    static const char *const FALSE_NAMES[] = { "no", "false", "off", "0" };
+    const char *value;
+    if (!sg_cvar_gets(section, name, &value))
+        return defval;
+    for (auto s : TRUE_NAMES)
+        if (!std::strcmp(value, s))
+            return true;
+    for (auto s : FALSE_NAMES)
+        if (!std::strcmp(value, s))
+            return false;
+    Log::warn("%s.%s: invalid boolean '%s'", section, name, value);
+    return defval;
+}
+
+int CVar::get_int(const char *section, const char *name, int defval) {
+    const char *value;
+    if (!sg_cvar_gets(section, name, &value))
+        return defval;
+    char *end;
+    long x = std::strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || x < -0x7fffffffL ||
+        x > 0x7fffffffL) {
+        Log::warn("%s.%s: invalid integer '%s'", section, name, value);
+        return defval;
+    }
+    return static_cast<int>(x);
+}
+
+}
@@ -0,0 +1,26 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_BASE_CVAR_HPP
+#define LD_BASE_CVAR_HPP
+#include <string>
+namespace Base {
+
+struct CVar {
+    /// Get a string configuration variable, or the default if unset.
+    static std::string get_string(const char *section, const char *name,
+                                  const char *defval);
+
+    /// Get a boolean configuration variable, or the default if unset
+    /// or invalid.
+    static bool get_bool(const char *section, const char *name,
+                         bool defval);
+
+    /// Get an integer configuration variable, or the default if unset
+    /// or invalid.
+    static int get_int(const char *section, const char *name,
+                       int defval);
+};
+
+}
+#endif
@@ -2,20 +2,92 @@
    This file is part of Dreamless.  Dreamless is licensed under the terms
    of the 2-clause BSD license.  For more information, see LICENSE.txt. */
 #include "sg/entry.h"
+#include "sg/error.h"
+#include "archive.hpp"
 #include "file.hpp"
 #include <cstdlib>
+#if defined _WIN32
+# include <windows.h>
+#else
+# include <errno.h>
+# include <sys/stat.h>
+#endif
 namespace Base {
 
+void Data::set(sg_buffer *buffer) {
+    if (m_buffer)
+        sg_buffer_decref(m_buffer);
+    m_buffer = buffer;
+    m_ptr = buffer->data;
+    m_size = buffer->length;
+}
+
+void Data::set(const void *ptr, std::size_t size) {
+    if (m_buffer)
+        sg_buffer_decref(m_buffer);
+    m_buffer = nullptr;
+    m_ptr = ptr;
+    m_size = size;
+}
+
 void Data::read(const std::string &path, size_t maxsz,
                 const char *extensions) {
+    const void *ptr;
+    std::size_t size;
+    if (Archive::find(path, extensions, &ptr, &size)) {
+        if (size > maxsz)
+            sg_sys_abortf("file too large: %s", path.c_str());
+        set(ptr, size);
+        return;
+    }
     sg_buffer *nbuf;
     nbuf = sg_file_get(path.data(), path.size(), SG_RDONLY,
                        extensions, maxsz, nullptr);
     if (!nbuf)
         sg_sys_abortf("could not read file: %s", path.c_str());
-    if (m_buffer)
-        sg_buffer_decref(m_buffer);
-    m_buffer = nbuf;
+    set(nbuf);
+}
+
+bool Data::read_optional(const std::string &path, size_t maxsz) {
+    const void *ptr;
+    std::size_t size;
+    if (Archive::find(path, &ptr, &size)) {
+        if (size > maxsz)
+            return false;
+        set(ptr, size);
+        return true;
+    }
+    sg_buffer *nbuf;
+    sg_error *err = nullptr;
+    nbuf = sg_file_get(path.data(), path.size(), SG_RDONLY,
+                       nullptr, maxsz, &err);
+    if (!nbuf) {
+        sg_error_clear(&err);
+        return false;
+    }
+    set(nbuf);
+    return true;
+}
+
+bool make_directory(const std::string &path) {
+    // Create each parent in turn, skipping the root.
+    std::string::size_type pos = 0;
+    while (true) {
+        pos = path.find_first_of("/\\", pos + 1);
+        std::string dir = path.substr(0, pos);
+        if (!dir.empty() && dir[dir.size() - 1] != ':') {
+#if defined _WIN32
+            if (!CreateDirectoryA(dir.c_str(), nullptr) &&
+                GetLastError() != ERROR_ALREADY_EXISTS)
+                return false;
+#else
+            if (mkdir(dir.c_str(), 0777) && errno != EEXIST)
+                return false;
+#endif
+        }
+        if (pos == std::string::npos)
+            return true;
+    }
 }
 
 }
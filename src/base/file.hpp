@@ -8,17 +8,30 @@
 #include <string>
 namespace Base {
 
+/// The contents of a file.  The data is either a view into the
+/// archive or a reference-counted buffer holding a loose file.
 class Data {
     sg_buffer *m_buffer;
+    const void *m_ptr;
+    std::size_t m_size;
+
+    void set(sg_buffer *buffer);
+    void set(const void *ptr, std::size_t size);
 
 public:
-    Data() : m_buffer(nullptr) { }
-    Data(const Data &other) : m_buffer(other.m_buffer) {
+    Data() : m_buffer(nullptr), m_ptr(nullptr), m_size(0) { }
+    Data(const Data &other)
+        : m_buffer(other.m_buffer), m_ptr(other.m_ptr),
+          m_size(other.m_size) {
         if (m_buffer)
             sg_buffer_incref(m_buffer);
     }
-    Data(Data &&other) : m_buffer(other.m_buffer) {
+    Data(Data &&other)
+        : m_buffer(other.m_buffer), m_ptr(other.m_ptr),
+          m_size(other.m_size) {
         other.m_buffer = nullptr;
+        other.m_ptr = nullptr;
+        other.m_size = 0;
     }
     ~Data() {
         if (m_buffer)
@@ -30,27 +43,44 @@ public:
         if (m_buffer)
             sg_buffer_decref(m_buffer);
         m_buffer = other.m_buffer;
+        m_ptr = other.m_ptr;
+        m_size = other.m_size;
         return *this;
     }
     Data &operator=(Data &&other) {
-        sg_buffer *tmp = other.m_buffer;
+        if (this == &other)
+            return *this;
+        if (m_buffer)
+            sg_buffer_decref(m_buffer);
+        m_buffer = other.m_buffer;
+        m_ptr = other.m_ptr;
+        m_size = other.m_size;
         other.m_buffer = nullptr;
-        m_buffer = tmp;
+        other.m_ptr = nullptr;
+        other.m_size = 0;
         return *this;
     }
 
     /// Get the start of the buffer.
-    const void *ptr() const { return m_buffer ? m_buffer->data : nullptr; }
+    const void *ptr() const { return m_ptr; }
     /// Get the number of bytes in the buffer.
-    std::size_t size() const { return m_buffer ? m_buffer->length : 0; }
+    std::size_t size() const { return m_size; }
     /// Read the contents of a file.
     void read(const std::string &path, size_t maxsz) {
         read(path, maxsz, nullptr);
     }
-    /// Read the contents of a file.
+    /// Read the contents of a file.  The extensions are a
+    /// colon-separated list to try, or null.
     void read(const std::string &path, size_t maxsz,
               const char *extensions);
+    /// Read the contents of a file, returning false if the file
+    /// cannot be read.
+    bool read_optional(const std::string &path, size_t maxsz);
 };
 
+/// Create a directory and any missing parents.  Returns false if the
+/// directory does not exist afterwards.
+bool make_directory(const std::string &path);
+
 }
 #endif
@@ -4,6 +4,8 @@
 #include "sg/entry.h"
 #include "file.hpp"
 #include "image.hpp"
+#include "ktx.hpp"
+#include "pixel.hpp"
 #include <cstdlib>
 #include <cstring>
 namespace Base {
@@ -49,39 +51,81 @@ void Image::copy_from(const Image &other, int x, int y) {
     size_t irb = other->rowbytes, orb = m_pixbuf.rowbytes;
     size_t xn = other->iwidth, yn = other->iheight;
 
+    PixelConv::Func func;
     if (other->format == m_pixbuf.format) {
         size_t psz = SG_PIXBUF_FORMATSIZE[m_pixbuf.format];
         for (size_t yi = 0; yi < yn; yi++)
             std::memcpy(op + orb * (yi + y) + psz * x,
                         ip + irb * yi, psz * xn);
+        return;
     } else if (m_pixbuf.format == SG_RGBA && other->format == SG_RGB) {
-        for (size_t yi = 0; yi < yn; yi++) {
-            const unsigned char *irp = ip + irb * yi;
-            unsigned char *orp = op + orb * (yi + y);
-            for (size_t xi = 0; xi < xn; xi++) {
-                orp[4 * (x + xi) + 0] = irp[3 * xi + 0];
-                orp[4 * (x + xi) + 1] = irp[3 * xi + 1];
-                orp[4 * (x + xi) + 2] = irp[3 * xi + 2];
-                orp[4 * (x + xi) + 3] = 255;
-            }
-        }
+        func = PixelConv::get().rgb_to_rgba;
     } else if (m_pixbuf.format == SG_RGBA && other->format == SG_RGBX) {
-        for (size_t yi = 0; yi < yn; yi++) {
-            const unsigned char *irp = ip + irb * yi;
-            unsigned char *orp = op + orb * (yi + y);
-            for (size_t xi = 0; xi < xn; xi++) {
-                orp[4 * (x + xi) + 0] = irp[4 * xi + 0];
-                orp[4 * (x + xi) + 1] = irp[4 * xi + 1];
-                orp[4 * (x + xi) + 2] = irp[4 * xi + 2];
-                orp[4 * (x + xi) + 3] = 255;
-            }
-        }
+        func = PixelConv::get().rgbx_to_rgba;
     } else {
         sg_sys_abortf(
             "mismatched pixel format: %s -> %s",
             SG_PIXBUF_FORMATNAME[other->format],
             SG_PIXBUF_FORMATNAME[m_pixbuf.format]);
     }
+    for (size_t yi = 0; yi < yn; yi++)
+        func(op + orb * (yi + y) + 4 * x, ip + irb * yi, xn);
+}
+
+void Image::premultiply() {
+    if (m_pixbuf.format != SG_RGBA)
+        return;
+    unsigned char *p = static_cast<unsigned char *>(m_pixbuf.data);
+    size_t rb = m_pixbuf.rowbytes;
+    auto func = PixelConv::get().premultiply;
+    for (int y = 0; y < m_pixbuf.iheight; y++)
+        func(p + rb * y, p + rb * y, m_pixbuf.iwidth);
+}
+
+void Image::copy_from_transposed(const Image &other, int x, int y) {
+    if (x < 0 || y < 0 ||
+        other->iheight > m_pixbuf.iwidth ||
+        other->iwidth > m_pixbuf.iheight ||
+        x > m_pixbuf.iwidth - other->iheight ||
+        y > m_pixbuf.iheight - other->iwidth)
+        sg_sys_abort("invalid image copy");
+
+    const unsigned char *ip = static_cast<const unsigned char *>(other->data);
+    unsigned char *op = static_cast<unsigned char *>(m_pixbuf.data);
+    size_t irb = other->rowbytes, orb = m_pixbuf.rowbytes;
+    size_t xn = other->iwidth, yn = other->iheight;
+    size_t isz = SG_PIXBUF_FORMATSIZE[other->format];
+    size_t osz = SG_PIXBUF_FORMATSIZE[m_pixbuf.format];
+
+    bool opaque;
+    if (other->format == m_pixbuf.format) {
+        opaque = false;
+    } else if (m_pixbuf.format == SG_RGBA &&
+               (other->format == SG_RGB || other->format == SG_RGBX)) {
+        opaque = true;
+    } else {
+        sg_sys_abortf(
+            "mismatched pixel format: %s -> %s",
+            SG_PIXBUF_FORMATNAME[other->format],
+            SG_PIXBUF_FORMATNAME[m_pixbuf.format]);
+    }
+
+    // Input row yi becomes output column x + yi.
+    for (size_t yi = 0; yi < yn; yi++) {
+        const unsigned char *irp = ip + irb * yi;
+        unsigned char *ocp = op + osz * (x + yi);
+        for (size_t xi = 0; xi < xn; xi++) {
+            unsigned char *opp = ocp + orb * (y + xi);
+            if (opaque) {
+                opp[0] = irp[isz * xi + 0];
+                opp[1] = irp[isz * xi + 1];
+                opp[2] = irp[isz * xi + 2];
+                opp[3] = 255;
+            } else {
+                std::memcpy(opp, irp + isz * xi, osz);
+            }
+        }
+    }
 }
 
 Texture::Texture()
@@ -91,6 +135,9 @@ Texture::Texture()
 { }
 
 Texture Texture::load(const std::string &path) {
+    KTXImage ktx;
+    if (ktx.load(path + ".ktx"))
+        return Texture::load(ktx);
     Image image;
     image.load(path);
     return Texture::load(image);
@@ -102,6 +149,7 @@ Texture::Texture(Texture &&other)
       twidth(other.twidth), theight(other.theight) {
     scale[0] = other.scale[0];
     scale[1] = other.scale[1];
+    other.tex = 0;
 }
 
 Texture::~Texture() {
@@ -134,7 +182,7 @@ struct FormatInfo {
 const FormatInfo FORMAT_INFO[SG_PIXBUF_NFORMAT] = {
     { GL_R8,    GL_RED,  GL_UNSIGNED_BYTE },
     { GL_RG8,   GL_RG,   GL_UNSIGNED_BYTE },
-    { GL_RGBA8, GL_RGB,  GL_UNSIGNED_BYTE },
+    { GL_RGB8,  GL_RGB,  GL_UNSIGNED_BYTE },
     { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
     { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE }
 };
@@ -172,6 +220,40 @@ Texture Texture::load(const Image &image) {
     return tex;
 }
 
+Texture Texture::load(const KTXImage &image) {
+    if (!image.supported()) {
+        Image decoded;
+        image.decode(decoded);
+        return Texture::load(decoded);
+    }
+
+    Texture tex;
+    tex.iwidth = image.width();
+    tex.iheight = image.height();
+    tex.twidth = image.width();
+    tex.theight = image.height();
+    tex.scale[0] = (float) (1.0 / tex.twidth);
+    tex.scale[1] = (float) (1.0 / tex.theight);
+
+    glGenTextures(1, &tex.tex);
+    glBindTexture(GL_TEXTURE_2D, tex.tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glCompressedTexImage2D(
+        GL_TEXTURE_2D,
+        0,
+        image.internal_format(),
+        tex.twidth,
+        tex.theight,
+        0,
+        static_cast<GLsizei>(image.size()),
+        image.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    sg_opengl_checkerror("Texture::load");
+    return tex;
+}
+
 Texture Texture::load_1d(const std::string &path) {
     Image image;
     image.load(path);
@@ -7,6 +7,7 @@
 #include "sg/pixbuf.h"
 #include <string>
 namespace Base {
+class KTXImage;
 
 class Image {
     sg_pixbuf m_pixbuf;
@@ -43,6 +44,11 @@ public:
     void calloc();
     void load(const std::string &path);
     void copy_from(const Image &other, int x, int y);
+    /// Convert straight alpha to premultiplied alpha, in place.  Only
+    /// affects RGBA images.
+    void premultiply();
+    /// Copy another image, transposed, so its top left is at (x, y).
+    void copy_from_transposed(const Image &other, int x, int y);
 };
 
 struct Texture {
@@ -60,9 +66,15 @@ struct Texture {
     Texture &operator=(const Texture &) = delete;
     Texture &operator=(Texture &&other);
 
-    /// Load an image as a 2-dimensional texture.
+    /// Load an image as a 2-dimensional texture.  A block-compressed
+    /// KTX file with the same name and ".ktx" appended is used
+    /// instead, if one exists.
     static Texture load(const std::string &path);
 
+    /// Load a block-compressed image as a 2-dimensional texture.
+    /// The image is decoded on the CPU if the format is unsupported.
+    static Texture load(const KTXImage &image);
+
     /// Load an image as a 2-dimensional texture.
     static Texture load(const Image &image);
 
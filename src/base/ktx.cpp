@@ -0,0 +1,454 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "ktx.hpp"
+#include "image.hpp"
+#include "opengl.hpp"
+#include "sg/entry.h"
+#include <cstring>
+namespace Base {
+
+namespace {
+
+const unsigned char KTX_IDENTIFIER[12] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+const std::size_t KTX_HEADER_SIZE = 64;
+
+// Not defined for desktop OpenGL.  ETC2 decoders accept ETC1 data.
+const GLenum ETC1_RGB8_OES = 0x8D64;
+
+struct FormatInfo {
+    GLenum ifmt;
+    CompressedFormat format;
+    int block_size;
+};
+
+const FormatInfo FORMATS[] = {
+    { GL_COMPRESSED_RGB_S3TC_DXT1_EXT,  CompressedFormat::DXT1,      8 },
+    { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, CompressedFormat::DXT1A,     8 },
+    { GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, CompressedFormat::DXT3,     16 },
+    { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, CompressedFormat::DXT5,     16 },
+    { ETC1_RGB8_OES,                    CompressedFormat::ETC1,      8 },
+    { GL_COMPRESSED_RGB8_ETC2,          CompressedFormat::ETC2,      8 },
+    { GL_COMPRESSED_RGBA8_ETC2_EAC,     CompressedFormat::ETC2_EAC, 16 },
+    { 0, CompressedFormat::DXT1, 0 }
+};
+
+unsigned read_u32(const unsigned char *p, bool swap) {
+    unsigned v;
+    std::memcpy(&v, p, 4);
+    if (swap) {
+        v = (v >> 24) | ((v >> 8) & 0xff00) |
+            ((v << 8) & 0xff0000) | (v << 24);
+    }
+    return v;
+}
+
+unsigned long long read_be64(const unsigned char *p) {
+    unsigned long long v = 0;
+    for (int i = 0; i < 8; i++)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+unsigned bits(unsigned long long v, int hi, int count) {
+    return static_cast<unsigned>(v >> (hi - count + 1)) &
+        ((1u << count) - 1);
+}
+
+unsigned char clamp(int x) {
+    return static_cast<unsigned char>(x < 0 ? 0 : x > 255 ? 255 : x);
+}
+
+// ============================================================
+// S3TC
+
+void decode_565(unsigned v, int *c) {
+    unsigned r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+// Decode a DXT color block into 16 RGBA pixels, row-major.
+void decode_dxt_color(const unsigned char *p, bool four_color,
+                      bool punchthrough, unsigned char (*out)[4]) {
+    unsigned c0 = p[0] | (p[1] << 8), c1 = p[2] | (p[3] << 8);
+    unsigned idx = p[4] | (p[5] << 8) | (p[6] << 16) |
+        (static_cast<unsigned>(p[7]) << 24);
+    int pal[4][4];
+    decode_565(c0, pal[0]);
+    decode_565(c1, pal[1]);
+    pal[0][3] = pal[1][3] = pal[2][3] = pal[3][3] = 255;
+    for (int i = 0; i < 3; i++) {
+        if (four_color || c0 > c1) {
+            pal[2][i] = (2 * pal[0][i] + pal[1][i]) / 3;
+            pal[3][i] = (pal[0][i] + 2 * pal[1][i]) / 3;
+        } else {
+            pal[2][i] = (pal[0][i] + pal[1][i]) / 2;
+            pal[3][i] = 0;
+        }
+    }
+    if (!four_color && c0 <= c1 && punchthrough)
+        pal[3][3] = 0;
+    for (int i = 0; i < 16; i++) {
+        const int *c = pal[(idx >> (2 * i)) & 3];
+        for (int j = 0; j < 4; j++)
+            out[i][j] = static_cast<unsigned char>(c[j]);
+    }
+}
+
+void decode_dxt3_alpha(const unsigned char *p, unsigned char (*out)[4]) {
+    for (int i = 0; i < 16; i++) {
+        unsigned a = (p[i >> 1] >> ((i & 1) * 4)) & 15;
+        out[i][3] = static_cast<unsigned char>(a * 17);
+    }
+}
+
+void decode_dxt5_alpha(const unsigned char *p, unsigned char (*out)[4]) {
+    int a0 = p[0], a1 = p[1];
+    int pal[8];
+    pal[0] = a0;
+    pal[1] = a1;
+    if (a0 > a1) {
+        for (int i = 1; i < 7; i++)
+            pal[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    } else {
+        for (int i = 1; i < 5; i++)
+            pal[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        pal[6] = 0;
+        pal[7] = 255;
+    }
+    unsigned long long idx = 0;
+    for (int i = 0; i < 6; i++)
+        idx |= static_cast<unsigned long long>(p[2 + i]) << (8 * i);
+    for (int i = 0; i < 16; i++)
+        out[i][3] = static_cast<unsigned char>(pal[(idx >> (3 * i)) & 7]);
+}
+
+// ============================================================
+// ETC2
+
+const int ETC_MODIFIER[8][4] = {
+    {  2,   8,  -2,   -8 }, {  5,  17,  -5,  -17 },
+    {  9,  29,  -9,  -29 }, { 13,  42, -13,  -42 },
+    { 18,  60, -18,  -60 }, { 24,  80, -24,  -80 },
+    { 33, 106, -33, -106 }, { 47, 183, -47, -183 }
+};
+
+const int ETC_DISTANCE[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+const int EAC_MODIFIER[16][8] = {
+    { -3, -6,  -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 },
+    { -2, -5,  -8, -13, 1, 4, 7, 12 }, { -2, -4,  -6, -13, 1, 3, 5, 12 },
+    { -3, -6,  -8, -12, 2, 5, 7, 11 }, { -3, -7,  -9, -11, 2, 6, 8, 10 },
+    { -4, -7,  -8, -11, 3, 6, 7, 10 }, { -3, -5,  -8, -11, 2, 4, 7, 10 },
+    { -2, -6,  -8, -10, 1, 5, 7,  9 }, { -2, -5,  -8, -10, 1, 4, 7,  9 },
+    { -2, -4,  -8, -10, 1, 3, 7,  9 }, { -2, -5,  -7, -10, 1, 4, 6,  9 },
+    { -3, -4,  -7, -10, 2, 3, 6,  9 }, { -1, -2,  -3, -10, 0, 1, 2,  9 },
+    { -4, -6,  -8,  -9, 3, 5, 7,  8 }, { -3, -5,  -7,  -9, 2, 4, 6,  8 }
+};
+
+int expand4(unsigned x) { return static_cast<int>(x * 17); }
+int expand5(unsigned x) { return static_cast<int>((x << 3) | (x >> 2)); }
+int expand6(unsigned x) { return static_cast<int>((x << 2) | (x >> 4)); }
+int expand7(unsigned x) { return static_cast<int>((x << 1) | (x >> 6)); }
+
+// Get the 2-bit index of pixel (x, y) in an ETC block.
+unsigned etc_index(unsigned long long v, int x, int y) {
+    int i = x * 4 + y;
+    return (bits(v, 16 + i, 1) << 1) | bits(v, i, 1);
+}
+
+// Decode an ETC2 RGB block into 16 RGBA pixels, row-major.
+void decode_etc2(const unsigned char *p, unsigned char (*out)[4]) {
+    unsigned long long v = read_be64(p);
+    int r = bits(v, 63, 5), g = bits(v, 55, 5), b = bits(v, 47, 5);
+    int dr = (static_cast<int>(bits(v, 58, 3)) ^ 4) - 4;
+    int dg = (static_cast<int>(bits(v, 50, 3)) ^ 4) - 4;
+    int db = (static_cast<int>(bits(v, 42, 3)) ^ 4) - 4;
+    bool diff = bits(v, 33, 1) != 0;
+    int pal[4][3];
+
+    if (diff && (r + dr < 0 || r + dr > 31)) {
+        // T mode.
+        int c1[3] = {
+            expand4((bits(v, 60, 2) << 2) | bits(v, 57, 2)),
+            expand4(bits(v, 55, 4)),
+            expand4(bits(v, 51, 4))
+        };
+        int c2[3] = {
+            expand4(bits(v, 47, 4)),
+            expand4(bits(v, 43, 4)),
+            expand4(bits(v, 39, 4))
+        };
+        int d = ETC_DISTANCE[(bits(v, 35, 2) << 1) | bits(v, 32, 1)];
+        for (int i = 0; i < 3; i++) {
+            pal[0][i] = c1[i];
+            pal[1][i] = c2[i] + d;
+            pal[2][i] = c2[i];
+            pal[3][i] = c2[i] - d;
+        }
+    } else if (diff && (g + dg < 0 || g + dg > 31)) {
+        // H mode.
+        unsigned r1 = bits(v, 62, 4);
+        unsigned g1 = (bits(v, 58, 3) << 1) | bits(v, 52, 1);
+        unsigned b1 = (bits(v, 51, 1) << 3) | bits(v, 49, 3);
+        unsigned r2 = bits(v, 46, 4), g2 = bits(v, 42, 4);
+        unsigned b2 = bits(v, 38, 4);
+        unsigned k1 = (r1 << 8) | (g1 << 4) | b1;
+        unsigned k2 = (r2 << 8) | (g2 << 4) | b2;
+        int d = ETC_DISTANCE[(bits(v, 34, 1) << 2) |
+                             (bits(v, 32, 1) << 1) | (k1 >= k2)];
+        int c1[3] = { expand4(r1), expand4(g1), expand4(b1) };
+        int c2[3] = { expand4(r2), expand4(g2), expand4(b2) };
+        for (int i = 0; i < 3; i++) {
+            pal[0][i] = c1[i] + d;
+            pal[1][i] = c1[i] - d;
+            pal[2][i] = c2[i] + d;
+            pal[3][i] = c2[i] - d;
+        }
+    } else if (diff && (b + db < 0 || b + db > 31)) {
+        // Planar mode, which has no palette.
+        int o[3] = {
+            expand6(bits(v, 62, 6)),
+            expand7((bits(v, 56, 1) << 6) | bits(v, 54, 6)),
+            expand6((bits(v, 48, 1) << 5) | (bits(v, 44, 2) << 3) |
+                    bits(v, 41, 3))
+        };
+        int h[3] = {
+            expand6((bits(v, 38, 5) << 1) | bits(v, 32, 1)),
+            expand7(bits(v, 31, 7)),
+            expand6(bits(v, 24, 6))
+        };
+        int w[3] = {
+            expand6(bits(v, 18, 6)),
+            expand7(bits(v, 12, 7)),
+            expand6(bits(v, 5, 6))
+        };
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                unsigned char *px = out[y * 4 + x];
+                for (int i = 0; i < 3; i++) {
+                    int c = x * (h[i] - o[i]) + y * (w[i] - o[i]) +
+                        4 * o[i] + 2;
+                    px[i] = clamp(c / 4);
+                }
+                px[3] = 255;
+            }
+        }
+        return;
+    } else {
+        // Individual or differential mode: two sub-blocks, each with
+        // a base color and a modifier table.
+        int base[2][3];
+        if (diff) {
+            base[0][0] = expand5(r);
+            base[0][1] = expand5(g);
+            base[0][2] = expand5(b);
+            base[1][0] = expand5(r + dr);
+            base[1][1] = expand5(g + dg);
+            base[1][2] = expand5(b + db);
+        } else {
+            for (int i = 0; i < 3; i++) {
+                base[0][i] = expand4(bits(v, 63 - 8 * i, 4));
+                base[1][i] = expand4(bits(v, 59 - 8 * i, 4));
+            }
+        }
+        const int *table[2] = {
+            ETC_MODIFIER[bits(v, 39, 3)],
+            ETC_MODIFIER[bits(v, 36, 3)]
+        };
+        bool flip = bits(v, 32, 1) != 0;
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                int sub = flip ? (y >= 2) : (x >= 2);
+                int m = table[sub][etc_index(v, x, y)];
+                unsigned char *px = out[y * 4 + x];
+                for (int i = 0; i < 3; i++)
+                    px[i] = clamp(base[sub][i] + m);
+                px[3] = 255;
+            }
+        }
+        return;
+    }
+
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            const int *c = pal[etc_index(v, x, y)];
+            unsigned char *px = out[y * 4 + x];
+            for (int i = 0; i < 3; i++)
+                px[i] = clamp(c[i]);
+            px[3] = 255;
+        }
+    }
+}
+
+// Decode an EAC alpha block into 16 RGBA pixels, row-major.
+void decode_eac(const unsigned char *p, unsigned char (*out)[4]) {
+    unsigned long long v = read_be64(p);
+    int base = bits(v, 63, 8);
+    int mul = bits(v, 55, 4);
+    const int *table = EAC_MODIFIER[bits(v, 51, 4)];
+    for (int x = 0; x < 4; x++) {
+        for (int y = 0; y < 4; y++) {
+            int idx = bits(v, 47 - 3 * (x * 4 + y), 3);
+            out[y * 4 + x][3] = clamp(base + table[idx] * mul);
+        }
+    }
+}
+
+const FormatInfo *find_format(GLenum ifmt) {
+    for (const FormatInfo *f = FORMATS; f->block_size; f++) {
+        if (f->ifmt == ifmt)
+            return f;
+    }
+    return nullptr;
+}
+
+const FormatInfo &get_format(CompressedFormat format) {
+    for (const FormatInfo *f = FORMATS; ; f++) {
+        if (f->format == format)
+            return *f;
+    }
+}
+
+}
+
+KTXImage::KTXImage()
+    : m_format(CompressedFormat::DXT1),
+      m_width(0), m_height(0),
+      m_ptr(nullptr), m_size(0)
+{ }
+
+bool KTXImage::load(const std::string &path) {
+    static const int MAX_SIZE = 1024 * 1024 * 16;
+    if (!m_data.read_optional(path, MAX_SIZE))
+        return false;
+
+    const unsigned char *p =
+        static_cast<const unsigned char *>(m_data.ptr());
+    std::size_t sz = m_data.size();
+    if (sz < KTX_HEADER_SIZE ||
+        std::memcmp(p, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)))
+        sg_sys_abortf("not a KTX file: %s", path.c_str());
+    unsigned endian = read_u32(p + 12, false);
+    bool swap;
+    if (endian == 0x04030201)
+        swap = false;
+    else if (endian == 0x01020304)
+        swap = true;
+    else
+        sg_sys_abortf("invalid KTX file: %s", path.c_str());
+
+    unsigned gl_type = read_u32(p + 16, swap);
+    unsigned ifmt = read_u32(p + 28, swap);
+    unsigned width = read_u32(p + 36, swap);
+    unsigned height = read_u32(p + 40, swap);
+    unsigned depth = read_u32(p + 44, swap);
+    unsigned array_elements = read_u32(p + 48, swap);
+    unsigned faces = read_u32(p + 52, swap);
+    unsigned kvbytes = read_u32(p + 60, swap);
+
+    const FormatInfo *info = find_format(ifmt);
+    if (gl_type != 0 || info == nullptr)
+        sg_sys_abortf("unsupported KTX format 0x%04x: %s",
+                      ifmt, path.c_str());
+    if (width == 0 || height == 0 || width > 8192 || height > 8192 ||
+        depth > 1 || array_elements > 0 || faces != 1)
+        sg_sys_abortf("unsupported KTX image: %s", path.c_str());
+
+    std::size_t pos = KTX_HEADER_SIZE + kvbytes;
+    std::size_t blocks =
+        static_cast<std::size_t>((width + 3) / 4) * ((height + 3) / 4);
+    std::size_t expect = blocks * info->block_size;
+    if (pos > sz || sz - pos < 4)
+        sg_sys_abortf("truncated KTX file: %s", path.c_str());
+    std::size_t isize = read_u32(p + pos, swap);
+    pos += 4;
+    if (isize != expect || sz - pos < isize)
+        sg_sys_abortf("truncated KTX file: %s", path.c_str());
+
+    m_format = info->format;
+    m_width = static_cast<int>(width);
+    m_height = static_cast<int>(height);
+    m_ptr = p + pos;
+    m_size = isize;
+    return true;
+}
+
+GLenum KTXImage::internal_format() const {
+    // ETC2 is a superset of ETC1, and desktop OpenGL only exposes ETC2.
+    if (m_format == CompressedFormat::ETC1)
+        return GL_COMPRESSED_RGB8_ETC2;
+    return get_format(m_format).ifmt;
+}
+
+bool KTXImage::supported() const {
+    switch (m_format) {
+    case CompressedFormat::DXT1:
+    case CompressedFormat::DXT1A:
+    case CompressedFormat::DXT3:
+    case CompressedFormat::DXT5:
+        return GLInfo::extension("GL_EXT_texture_compression_s3tc");
+
+    case CompressedFormat::ETC1:
+    case CompressedFormat::ETC2:
+    case CompressedFormat::ETC2_EAC:
+        return GLInfo::version(4, 3) ||
+            GLInfo::extension("GL_ARB_ES3_compatibility");
+    }
+    return false;
+}
+
+void KTXImage::decode(Image &image) const {
+    image.set(SG_RGBA, m_width, m_height);
+    image.alloc();
+
+    int bsize = get_format(m_format).block_size;
+    int bw = (m_width + 3) / 4, bh = (m_height + 3) / 4;
+    unsigned char *op = static_cast<unsigned char *>(image->data);
+    std::size_t orb = image->rowbytes;
+    const unsigned char *ip = m_ptr;
+    unsigned char block[16][4];
+
+    for (int by = 0; by < bh; by++) {
+        for (int bx = 0; bx < bw; bx++, ip += bsize) {
+            switch (m_format) {
+            case CompressedFormat::DXT1:
+                decode_dxt_color(ip, false, false, block);
+                break;
+            case CompressedFormat::DXT1A:
+                decode_dxt_color(ip, false, true, block);
+                break;
+            case CompressedFormat::DXT3:
+                decode_dxt_color(ip + 8, true, false, block);
+                decode_dxt3_alpha(ip, block);
+                break;
+            case CompressedFormat::DXT5:
+                decode_dxt_color(ip + 8, true, false, block);
+                decode_dxt5_alpha(ip, block);
+                break;
+            case CompressedFormat::ETC1:
+            case CompressedFormat::ETC2:
+                decode_etc2(ip, block);
+                break;
+            case CompressedFormat::ETC2_EAC:
+                decode_etc2(ip + 8, block);
+                decode_eac(ip, block);
+                break;
+            }
+
+            int xn = m_width - bx * 4, yn = m_height - by * 4;
+            if (xn > 4) xn = 4;
+            if (yn > 4) yn = 4;
+            for (int y = 0; y < yn; y++) {
+                std::memcpy(op + orb * (by * 4 + y) + 16 * bx,
+                            block[y * 4], 4 * xn);
+            }
+        }
+    }
+}
+
+}
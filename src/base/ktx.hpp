@@ -0,0 +1,51 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_BASE_KTX_HPP
+#define LD_BASE_KTX_HPP
+#include "file.hpp"
+#include "sg/opengl.h"
+#include <string>
+namespace Base {
+class Image;
+
+/// Block-compressed texture formats.
+enum class CompressedFormat {
+    DXT1, DXT1A, DXT3, DXT5, ETC1, ETC2, ETC2_EAC
+};
+
+/// A block-compressed image, loaded from a KTX file.  Only the
+/// first mipmap level is used.
+class KTXImage {
+private:
+    Data m_data;
+    CompressedFormat m_format;
+    int m_width;
+    int m_height;
+    const unsigned char *m_ptr;
+    std::size_t m_size;
+
+public:
+    KTXImage();
+
+    /// Load a KTX file.  Returns false if the file does not exist,
+    /// and aborts if it is invalid or uses an unknown format.
+    bool load(const std::string &path);
+
+    /// Determine whether the OpenGL implementation can use the
+    /// compressed data directly.
+    bool supported() const;
+    /// Decode the image to RGBA.
+    void decode(Image &image) const;
+
+    /// Get the OpenGL internal format of the compressed data.
+    GLenum internal_format() const;
+    CompressedFormat format() const { return m_format; }
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    const void *data() const { return m_ptr; }
+    std::size_t size() const { return m_size; }
+};
+
+}
+#endif
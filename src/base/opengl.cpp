@@ -0,0 +1,63 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "opengl.hpp"
+#include "sg/opengl.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+namespace Base {
+
+namespace {
+
+bool is_initialized;
+int gl_major, gl_minor;
+std::unordered_set<std::string> gl_extensions;
+
+void init() {
+    if (is_initialized)
+        return;
+    is_initialized = true;
+
+    const char *version =
+        reinterpret_cast<const char *>(glGetString(GL_VERSION));
+    if (!version || std::sscanf(version, "%d.%d", &gl_major, &gl_minor) != 2)
+        gl_major = gl_minor = 0;
+
+    if (gl_major >= 3) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char *name = reinterpret_cast<const char *>(
+                glGetStringi(GL_EXTENSIONS, i));
+            if (name)
+                gl_extensions.insert(name);
+        }
+    } else {
+        const char *ptr =
+            reinterpret_cast<const char *>(glGetString(GL_EXTENSIONS));
+        while (ptr && *ptr) {
+            const char *end = std::strchr(ptr, ' ');
+            if (!end)
+                end = ptr + std::strlen(ptr);
+            if (end != ptr)
+                gl_extensions.insert(std::string(ptr, end));
+            ptr = *end ? end + 1 : end;
+        }
+    }
+}
+
+}
+
+bool GLInfo::version(int major, int minor) {
+    init();
+    return gl_major > major || (gl_major == major && gl_minor >= minor);
+}
+
+bool GLInfo::extension(const char *name) {
+    init();
+    return gl_extensions.count(name) != 0;
+}
+
+}
@@ -0,0 +1,20 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_BASE_OPENGL_HPP
+#define LD_BASE_OPENGL_HPP
+namespace Base {
+
+/// Information about the OpenGL implementation.  Must only be used
+/// from the thread with the OpenGL context.
+struct GLInfo {
+    /// Determine whether the OpenGL version is at least the given
+    /// version.
+    static bool version(int major, int minor);
+
+    /// Determine whether the given extension is supported.
+    static bool extension(const char *name);
+};
+
+}
+#endif
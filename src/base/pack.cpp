@@ -3,6 +3,7 @@
    of the 2-clause BSD license.  For more information, see LICENSE.txt. */
 #include <algorithm>
 #include <cstdlib>
+#include <limits>
 #include <vector>
 #include <assert.h>
 #include "sg/entry.h"
@@ -18,13 +19,25 @@ struct Packing::Rect {
 };
 
 bool Packing::Rect::operator<(const Rect &other) const {
-    if (rectsize.width > other.rectsize.width)
-        return true;
-    if (rectsize.width < other.rectsize.width)
-        return false;
-    return rectsize.height > other.rectsize.height;
+    int a = std::max(rectsize.width, rectsize.height);
+    int b = std::max(other.rectsize.width, other.rectsize.height);
+    if (a != b)
+        return a > b;
+    return rectsize.width * rectsize.height >
+        other.rectsize.width * other.rectsize.height;
 }
 
+// A maximal free rectangle in a page.
+struct Packing::Free {
+    int x, y, width, height;
+
+    bool contains(const Free &other) const {
+        return other.x >= x && other.y >= y &&
+            other.x + other.width <= x + width &&
+            other.y + other.height <= y + height;
+    }
+};
+
 // Metrics for how good a packing is.
 struct Packing::Metrics {
     int area;
@@ -51,91 +64,194 @@ bool Packing::Metrics::operator<(const Metrics &other) const {
     return nonsquare < other.nonsquare;
 }
 
-// Packing state.
+// Packing state, using the MaxRects algorithm with the best short
+// side fit heuristic.
 struct Packing::State {
-    std::vector<int> frontier;
-    Packing result;
+    bool allow_rotate;
+    std::vector<Free> free;
     std::vector<Rect> rects;
+    std::vector<Location> locations;
+    std::vector<bool> placed;
+    // The rectangles placed by the last pass, and their total area.
+    std::vector<std::size_t> pass;
+    std::size_t used;
 
-    bool try_pack(int width, int height);
+    bool try_pack(int width, int height, bool require_all);
+    bool find(int width, int height, Location &loc);
+    void place(const Free &r);
 };
 
-bool Packing::State::try_pack(int width, int height) {
-    frontier.clear();
-    frontier.resize(height, 0);
-    result.locations.resize(rects.size());
-    result.packsize.width = width;
-    result.packsize.height = height;
-    int ypos = 0;
+bool Packing::State::try_pack(int width, int height, bool require_all) {
+    Free page = { 0, 0, width, height };
+    free.clear();
+    free.push_back(page);
+    pass.clear();
+    used = 0;
     for (auto rect : rects) {
-        int sw = rect.rectsize.width, sh = rect.rectsize.height;
         std::size_t index = rect.index;
-        if (ypos + sw > height)
-            ypos = 0;
-        while (ypos + sh <= height && frontier[ypos] + sw > width)
-            ypos++;
-        if (ypos + sh > height)
-            return false;
-        int xpos = frontier[ypos];
-        for (int i = 0; i < ypos + sh; i++) {
-            if (frontier[i] < xpos + sw)
-                frontier[i] = xpos + sw;
+        if (placed[index])
+            continue;
+        Location loc;
+        if (!find(rect.rectsize.width, rect.rectsize.height, loc)) {
+            if (require_all)
+                return false;
+            continue;
         }
-        assert(0 <= ypos && ypos <= height - sh);
-        assert(0 <= xpos && xpos <= width - sw);
-        result.locations[index].x = xpos;
-        result.locations[index].y = ypos;
-        ypos += sh;
+        Free r = { loc.x, loc.y, rect.rectsize.width, rect.rectsize.height };
+        if (loc.rotated)
+            std::swap(r.width, r.height);
+        assert(0 <= r.x && r.x <= width - r.width);
+        assert(0 <= r.y && r.y <= height - r.height);
+        place(r);
+        locations[index] = loc;
+        pass.push_back(index);
+        used += static_cast<std::size_t>(r.width) *
+            static_cast<std::size_t>(r.height);
     }
     return true;
 }
 
-Packing Packing::pack(const std::vector<Size> &rects) {
+bool Packing::State::find(int width, int height, Location &loc) {
+    int best_short = std::numeric_limits<int>::max();
+    int best_long = std::numeric_limits<int>::max();
+    for (auto &f : free) {
+        for (int rot = 0; rot < (allow_rotate ? 2 : 1); rot++) {
+            int w = rot ? height : width, h = rot ? width : height;
+            if (w > f.width || h > f.height)
+                continue;
+            int dx = f.width - w, dy = f.height - h;
+            int short_side = std::min(dx, dy), long_side = std::max(dx, dy);
+            if (short_side < best_short ||
+                (short_side == best_short && long_side < best_long)) {
+                best_short = short_side;
+                best_long = long_side;
+                loc.x = f.x;
+                loc.y = f.y;
+                loc.page = 0;
+                loc.rotated = rot != 0;
+            }
+        }
+    }
+    return best_short != std::numeric_limits<int>::max();
+}
+
+void Packing::State::place(const Free &r) {
+    // Split every free rectangle which overlaps the placed rectangle
+    // into the maximal rectangles around it.
+    std::size_t n = free.size();
+    for (std::size_t i = 0; i < n; ) {
+        Free f = free[i];
+        if (r.x >= f.x + f.width || r.x + r.width <= f.x ||
+            r.y >= f.y + f.height || r.y + r.height <= f.y) {
+            i++;
+            continue;
+        }
+        free[i] = free[--n];
+        free[n] = free.back();
+        free.pop_back();
+        if (r.x > f.x) {
+            Free s = { f.x, f.y, r.x - f.x, f.height };
+            free.push_back(s);
+        }
+        if (r.x + r.width < f.x + f.width) {
+            Free s = { r.x + r.width, f.y,
+                       f.x + f.width - r.x - r.width, f.height };
+            free.push_back(s);
+        }
+        if (r.y > f.y) {
+            Free s = { f.x, f.y, f.width, r.y - f.y };
+            free.push_back(s);
+        }
+        if (r.y + r.height < f.y + f.height) {
+            Free s = { f.x, r.y + r.height,
+                       f.width, f.y + f.height - r.y - r.height };
+            free.push_back(s);
+        }
+    }
+
+    // Remove free rectangles contained in other free rectangles.
+    for (std::size_t i = 0; i < free.size(); i++) {
+        for (std::size_t j = i + 1; j < free.size(); ) {
+            if (free[i].contains(free[j])) {
+                free[j] = free.back();
+                free.pop_back();
+            } else if (free[j].contains(free[i])) {
+                free[i] = free[j];
+                free[j] = free.back();
+                free.pop_back();
+                j = i + 1;
+            } else {
+                j++;
+            }
+        }
+    }
+}
+
+Packing Packing::pack(const std::vector<Size> &rects, int maxsize,
+                      bool allow_rotate) {
     State packer;
-    std::size_t rectarea = 0;
+    packer.allow_rotate = allow_rotate;
     packer.rects.reserve(rects.size());
     for (std::size_t i = 0; i < rects.size(); i++) {
         Rect r;
         r.rectsize = rects[i];
         r.index = i;
         packer.rects.push_back(r);
-        rectarea += static_cast<std::size_t>(rects[i].width) *
-            static_cast<std::size_t>(rects[i].height);
+        if (rects[i].width > maxsize || rects[i].height > maxsize)
+            sg_sys_abort("could not pack sprites");
     }
     std::sort(packer.rects.begin(), packer.rects.end());
+    packer.locations.resize(rects.size());
+    packer.placed.resize(rects.size(), false);
 
-    bool havepacking = false;
-    Packing bestpacking;
-    for (int i = 4; i < 10; i++) {
-        int height = 1 << i;
-        bool success = false;
-        for (int j = 4; j < 10; j++) {
-            int width = 1 << j;
-            if (rectarea > static_cast<std::size_t>(1) << (i + j))
-                continue;
-            if (packer.try_pack(width, height)) {
-                success = true;
+    Packing result;
+    result.locations.resize(rects.size());
+    std::size_t remaining = rects.size();
+    while (remaining > 0) {
+        std::size_t rectarea = 0;
+        for (auto &r : packer.rects) {
+            if (!packer.placed[r.index])
+                rectarea += static_cast<std::size_t>(r.rectsize.width) *
+                    static_cast<std::size_t>(r.rectsize.height);
+        }
+
+        // Find the smallest page that holds all remaining rectangles.
+        bool havepacking = false;
+        Size bestsize = { maxsize, maxsize };
+        for (int height = 16; height <= maxsize; height <<= 1) {
+            for (int width = 16; width <= maxsize; width <<= 1) {
+                if (rectarea > static_cast<std::size_t>(width) *
+                    static_cast<std::size_t>(height))
+                    continue;
+                if (!packer.try_pack(width, height, true))
+                    continue;
+                Size size = { width, height };
+                if (!havepacking || Metrics(size) < Metrics(bestsize)) {
+                    bestsize = size;
+                    havepacking = true;
+                }
                 break;
             }
         }
-        if (!success)
-            continue;
-        if (havepacking) {
-            Metrics curmetrics(packer.result.packsize);
-            Metrics bestmetrics(bestpacking.packsize);
-            if (curmetrics < bestmetrics) {
-                Packing temp(std::move(bestpacking));
-                bestpacking = std::move(packer.result);
-                packer.result = std::move(temp);
-            }
-        } else {
-            bestpacking = std::move(packer.result);
-            havepacking = true;
+
+        // Repeat the best packing.  If nothing holds all the remaining
+        // rectangles, this fills a page of the maximum size, and the
+        // rest go on the next page.
+        packer.try_pack(bestsize.width, bestsize.height, false);
+        if (packer.pass.empty())
+            sg_sys_abort("could not pack sprites");
+        int pageindex = static_cast<int>(result.pages.size());
+        for (std::size_t index : packer.pass) {
+            Location loc = packer.locations[index];
+            loc.page = pageindex;
+            result.locations[index] = loc;
+            packer.placed[index] = true;
         }
+        remaining -= packer.pass.size();
+        Page page = { bestsize, packer.used };
+        result.pages.push_back(page);
     }
-    if (!havepacking)
-        sg_sys_abort("could not pack sprites");
-    return bestpacking;
+    return result;
 }
 
 }
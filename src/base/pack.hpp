@@ -10,6 +10,7 @@ namespace Base {
 /// A complete packing of a set of rectangles.
 struct Packing {
     struct Rect;
+    struct Free;
     struct State;
     struct Metrics;
 
@@ -23,16 +24,33 @@ struct Packing {
     struct Location {
         int x;
         int y;
+        /// The page containing the rectangle.
+        int page;
+        /// If true, the rectangle is transposed, so its width runs
+        /// along the page's Y axis.
+        bool rotated;
     };
 
-    /// The size of the rectangle enclosing the packed rectangles.
-    Size packsize;
+    /// A page, which encloses some of the packed rectangles.
+    struct Page {
+        /// The size of the page.
+        Size size;
+        /// The total area of the rectangles on the page.
+        std::size_t used;
+    };
+
+    /// The pages.  Each page has power of two dimensions.
+    std::vector<Page> pages;
 
     /// The location of the packed rectangles.
     std::vector<Location> locations;
 
-    /// Efficiently pack a set of rectangles in a larger rectangle.
-    static Packing pack(const std::vector<Size> &rects);
+    /// Efficiently pack a set of rectangles in pages no larger than
+    /// the given size, which must be a power of two.  Rectangles are
+    /// transposed if allowed and if that packs better.  Additional
+    /// pages are added if the rectangles do not fit on one page.
+    static Packing pack(const std::vector<Size> &rects, int maxsize,
+                        bool allow_rotate);
 };
 
 }
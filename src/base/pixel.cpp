@@ -0,0 +1,340 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "pixel.hpp"
+#include "clock.hpp"
+#include "log.hpp"
+#include "random.hpp"
+#include <cstring>
+#include <vector>
+#if (defined __GNUC__ || defined __clang__) && \
+    (defined __i386__ || defined __x86_64__)
+#define LD_PIXEL_X86 1
+#include <immintrin.h>
+#endif
+namespace Base {
+
+namespace {
+
+// Multiply two bytes and divide by 255, rounding to nearest.  This is
+// exact, and the SIMD kernels use the same arithmetic.
+inline unsigned mul255(unsigned x, unsigned y) {
+    unsigned t = x * y + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+// ============================================================
+// Scalar
+
+void scalar_rgb_to_rgba(unsigned char *dest, const unsigned char *src,
+                        std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+        dest[4 * i + 0] = src[3 * i + 0];
+        dest[4 * i + 1] = src[3 * i + 1];
+        dest[4 * i + 2] = src[3 * i + 2];
+        dest[4 * i + 3] = 255;
+    }
+}
+
+void scalar_rgbx_to_rgba(unsigned char *dest, const unsigned char *src,
+                         std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+        dest[4 * i + 0] = src[4 * i + 0];
+        dest[4 * i + 1] = src[4 * i + 1];
+        dest[4 * i + 2] = src[4 * i + 2];
+        dest[4 * i + 3] = 255;
+    }
+}
+
+void scalar_premultiply(unsigned char *dest, const unsigned char *src,
+                        std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+        unsigned a = src[4 * i + 3];
+        dest[4 * i + 0] = static_cast<unsigned char>(
+            mul255(src[4 * i + 0], a));
+        dest[4 * i + 1] = static_cast<unsigned char>(
+            mul255(src[4 * i + 1], a));
+        dest[4 * i + 2] = static_cast<unsigned char>(
+            mul255(src[4 * i + 2], a));
+        dest[4 * i + 3] = static_cast<unsigned char>(a);
+    }
+}
+
+const PixelConv SCALAR = {
+    "scalar",
+    scalar_rgb_to_rgba,
+    scalar_rgbx_to_rgba,
+    scalar_premultiply
+};
+
+#if defined LD_PIXEL_X86
+
+// ============================================================
+// SSSE3
+
+#define X -128
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+TARGET_SSSE3
+void ssse3_rgb_to_rgba(unsigned char *dest, const unsigned char *src,
+                       std::size_t count) {
+    const __m128i shuf = _mm_setr_epi8(
+        0, 1, 2, X, 3, 4, 5, X, 6, 7, 8, X, 9, 10, 11, X);
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i *ip = reinterpret_cast<const __m128i *>(src + 3 * i);
+        __m128i *op = reinterpret_cast<__m128i *>(dest + 4 * i);
+        __m128i a = _mm_loadu_si128(ip + 0);
+        __m128i b = _mm_loadu_si128(ip + 1);
+        __m128i c = _mm_loadu_si128(ip + 2);
+        _mm_storeu_si128(
+            op + 0, _mm_or_si128(_mm_shuffle_epi8(a, shuf), alpha));
+        _mm_storeu_si128(
+            op + 1, _mm_or_si128(
+                _mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), shuf), alpha));
+        _mm_storeu_si128(
+            op + 2, _mm_or_si128(
+                _mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), shuf), alpha));
+        _mm_storeu_si128(
+            op + 3, _mm_or_si128(
+                _mm_shuffle_epi8(_mm_srli_si128(c, 4), shuf), alpha));
+    }
+    scalar_rgb_to_rgba(dest + 4 * i, src + 3 * i, count - i);
+}
+
+TARGET_SSSE3
+void ssse3_rgbx_to_rgba(unsigned char *dest, const unsigned char *src,
+                        std::size_t count) {
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(src + 4 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + 4 * i),
+                         _mm_or_si128(x, alpha));
+    }
+    scalar_rgbx_to_rgba(dest + 4 * i, src + 4 * i, count - i);
+}
+
+// Premultiply eight 16-bit channels by the alpha in each pixel.  The
+// alpha channel is multiplied by 255, which leaves it unchanged.
+TARGET_SSSE3
+inline __m128i ssse3_mul255(__m128i x, __m128i a) {
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, a), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+TARGET_SSSE3
+void ssse3_premultiply(unsigned char *dest, const unsigned char *src,
+                       std::size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i shuf_lo = _mm_setr_epi8(
+        3, X, 3, X, 3, X, X, X, 7, X, 7, X, 7, X, X, X);
+    const __m128i shuf_hi = _mm_setr_epi8(
+        11, X, 11, X, 11, X, X, X, 15, X, 15, X, 15, X, X, X);
+    const __m128i opaque = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(src + 4 * i));
+        __m128i lo = _mm_unpacklo_epi8(x, zero);
+        __m128i hi = _mm_unpackhi_epi8(x, zero);
+        __m128i alo = _mm_or_si128(_mm_shuffle_epi8(x, shuf_lo), opaque);
+        __m128i ahi = _mm_or_si128(_mm_shuffle_epi8(x, shuf_hi), opaque);
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i *>(dest + 4 * i),
+            _mm_packus_epi16(ssse3_mul255(lo, alo), ssse3_mul255(hi, ahi)));
+    }
+    scalar_premultiply(dest + 4 * i, src + 4 * i, count - i);
+}
+
+const PixelConv SSSE3 = {
+    "ssse3",
+    ssse3_rgb_to_rgba,
+    ssse3_rgbx_to_rgba,
+    ssse3_premultiply
+};
+
+// ============================================================
+// AVX2
+
+TARGET_AVX2
+void avx2_rgb_to_rgba(unsigned char *dest, const unsigned char *src,
+                      std::size_t count) {
+    // Each lane gets 12 bytes of input, the same shuffle as SSSE3.
+    const __m256i perm = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+    const __m256i shuf = _mm256_setr_epi8(
+        0, 1, 2, X, 3, 4, 5, X, 6, 7, 8, X, 9, 10, 11, X,
+        0, 1, 2, X, 3, 4, 5, X, 6, 7, 8, X, 9, 10, 11, X);
+    const __m256i alpha = _mm256_set1_epi32(0xff000000);
+    std::size_t i = 0;
+    // The load reads 32 bytes but only uses 24, so stop early.
+    for (; i + 11 <= count; i += 8) {
+        __m256i x = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(src + 3 * i));
+        x = _mm256_permutevar8x32_epi32(x, perm);
+        x = _mm256_or_si256(_mm256_shuffle_epi8(x, shuf), alpha);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + 4 * i), x);
+    }
+    ssse3_rgb_to_rgba(dest + 4 * i, src + 3 * i, count - i);
+}
+
+TARGET_AVX2
+void avx2_rgbx_to_rgba(unsigned char *dest, const unsigned char *src,
+                       std::size_t count) {
+    const __m256i alpha = _mm256_set1_epi32(0xff000000);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i x = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(src + 4 * i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + 4 * i),
+                            _mm256_or_si256(x, alpha));
+    }
+    ssse3_rgbx_to_rgba(dest + 4 * i, src + 4 * i, count - i);
+}
+
+TARGET_AVX2
+inline __m256i avx2_mul255(__m256i x, __m256i a) {
+    __m256i t = _mm256_add_epi16(
+        _mm256_mullo_epi16(x, a), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(
+        _mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+TARGET_AVX2
+void avx2_premultiply(unsigned char *dest, const unsigned char *src,
+                      std::size_t count) {
+    // Unpack and pack work within each 128-bit lane, so the shuffles
+    // are the same as SSSE3, repeated for both lanes.
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i shuf_lo = _mm256_setr_epi8(
+        3, X, 3, X, 3, X, X, X, 7, X, 7, X, 7, X, X, X,
+        3, X, 3, X, 3, X, X, X, 7, X, 7, X, 7, X, X, X);
+    const __m256i shuf_hi = _mm256_setr_epi8(
+        11, X, 11, X, 11, X, X, X, 15, X, 15, X, 15, X, X, X,
+        11, X, 11, X, 11, X, X, X, 15, X, 15, X, 15, X, X, X);
+    const __m256i opaque = _mm256_setr_epi16(
+        0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i x = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(src + 4 * i));
+        __m256i lo = _mm256_unpacklo_epi8(x, zero);
+        __m256i hi = _mm256_unpackhi_epi8(x, zero);
+        __m256i alo = _mm256_or_si256(
+            _mm256_shuffle_epi8(x, shuf_lo), opaque);
+        __m256i ahi = _mm256_or_si256(
+            _mm256_shuffle_epi8(x, shuf_hi), opaque);
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i *>(dest + 4 * i),
+            _mm256_packus_epi16(avx2_mul255(lo, alo),
+                                avx2_mul255(hi, ahi)));
+    }
+    ssse3_premultiply(dest + 4 * i, src + 4 * i, count - i);
+}
+
+const PixelConv AVX2 = {
+    "avx2",
+    avx2_rgb_to_rgba,
+    avx2_rgbx_to_rgba,
+    avx2_premultiply
+};
+
+#undef X
+#undef TARGET_SSSE3
+#undef TARGET_AVX2
+
+#endif
+
+const PixelConv &select() {
+#if defined LD_PIXEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return AVX2;
+    if (__builtin_cpu_supports("ssse3"))
+        return SSSE3;
+#endif
+    return SCALAR;
+}
+
+// Time a kernel, returning the best of several runs in microseconds.
+long long bench(PixelConv::Func func, unsigned char *dest,
+                const unsigned char *src, std::size_t count) {
+    static const int RUNS = 16;
+    long long best = -1;
+    for (int i = 0; i < RUNS; i++) {
+        long long t0 = Clock::micros();
+        func(dest, src, count);
+        long long t = Clock::micros() - t0;
+        if (best < 0 || t < best)
+            best = t;
+    }
+    return best;
+}
+
+}
+
+const PixelConv &PixelConv::get() {
+    static const PixelConv &conv = select();
+    return conv;
+}
+
+const PixelConv &PixelConv::scalar() {
+    return SCALAR;
+}
+
+void PixelConv::benchmark() {
+    // An odd size, so the scalar tails are exercised too.
+    static const std::size_t COUNT = 512 * 512 + 7;
+    static const char *const NAMES[3] = {
+        "rgb_to_rgba", "rgbx_to_rgba", "premultiply"
+    };
+    static Func PixelConv::*const KERNELS[3] = {
+        &PixelConv::rgb_to_rgba,
+        &PixelConv::rgbx_to_rgba,
+        &PixelConv::premultiply
+    };
+
+    std::vector<const PixelConv *> convs;
+    convs.push_back(&SCALAR);
+#if defined LD_PIXEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+        convs.push_back(&SSSE3);
+    if (__builtin_cpu_supports("avx2"))
+        convs.push_back(&AVX2);
+#endif
+    Log::info("Pixel conversion: using %s", get().name);
+
+    Random rand = { 123456789, 362436069, 521288629, 88675123 };
+    std::vector<unsigned char> src(COUNT * 4), expect(COUNT * 4),
+        dest(COUNT * 4);
+    for (auto &x : src)
+        x = static_cast<unsigned char>(rand.next());
+
+    for (int k = 0; k < 3; k++) {
+        (SCALAR.*KERNELS[k])(expect.data(), src.data(), COUNT);
+        long long base = 0;
+        for (auto conv : convs) {
+            Func func = conv->*KERNELS[k];
+            std::memset(dest.data(), 0, dest.size());
+            long long t = bench(func, dest.data(), src.data(), COUNT);
+            if (conv == &SCALAR)
+                base = t;
+            bool ok = std::memcmp(dest.data(), expect.data(),
+                                  COUNT * 4) == 0;
+            Log::info("%s (%s): %lld us, %.1fx%s",
+                      NAMES[k], conv->name, t,
+                      t > 0 ? static_cast<double>(base) /
+                      static_cast<double>(t) : 0.0,
+                      ok ? "" : ", MISMATCH");
+            if (!ok)
+                Log::error("pixel conversion %s (%s) is incorrect",
+                           NAMES[k], conv->name);
+        }
+    }
+}
+
+}
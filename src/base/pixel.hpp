@@ -0,0 +1,36 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_BASE_PIXEL_HPP
+#define LD_BASE_PIXEL_HPP
+#include <cstddef>
+namespace Base {
+
+/// Pixel format conversion kernels.  Each kernel converts a row of
+/// pixels, and the best implementation for the CPU is chosen at
+/// runtime.
+struct PixelConv {
+    typedef void (*Func)(unsigned char *dest, const unsigned char *src,
+                         std::size_t count);
+
+    /// Name of the instruction set used by these kernels.
+    const char *name;
+    /// Convert RGB to RGBA, with opaque alpha.
+    Func rgb_to_rgba;
+    /// Convert RGBX to RGBA, with opaque alpha.
+    Func rgbx_to_rgba;
+    /// Convert RGBA to premultiplied RGBA.  The source and destination
+    /// may be the same.
+    Func premultiply;
+
+    /// Get the fastest kernels supported by this CPU.
+    static const PixelConv &get();
+    /// Get the portable scalar kernels.
+    static const PixelConv &scalar();
+    /// Check that every implementation matches the scalar kernels and
+    /// log how long each one takes.
+    static void benchmark();
+};
+
+}
+#endif
@@ -0,0 +1,190 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "profile.hpp"
+#include "cvar.hpp"
+#include "log.hpp"
+#include "thread.hpp"
+#include <atomic>
+#include <cstdio>
+#include <ctime>
+namespace Base {
+
+namespace {
+
+// Smoothing factor for the per-frame average.
+const double SMOOTHING = 0.05;
+// Maximum number of trace events, about 40 MB of JSON.
+const std::size_t MAX_EVENTS = 1 << 19;
+// Thread ID used for GPU passes in traces.
+const int GPU_THREAD = 0;
+
+struct Slot {
+    ProfileEntry entry;
+    long long total;
+    unsigned count;
+    AllocStats allocs;
+};
+
+struct Event {
+    const char *name;
+    int thread;
+    long long start;
+    long long duration;
+};
+
+std::atomic<bool> is_enabled(false);
+std::atomic<bool> is_tracing(false);
+std::atomic<int> thread_counter(GPU_THREAD);
+
+Mutex &profile_lock() {
+    static Mutex mutex;
+    return mutex;
+}
+
+// Everything below is protected by the profile lock.
+std::vector<Slot> slots;
+std::vector<Event> events;
+long long trace_start;
+
+int thread_id() {
+    static thread_local int id = ++thread_counter;
+    return id;
+}
+
+Slot &get_slot(const char *name, bool gpu) {
+    for (auto &slot : slots) {
+        if (slot.entry.name == name)
+            return slot;
+    }
+    Slot slot;
+    slot.entry.name = name;
+    slot.entry.gpu = gpu;
+    slot.entry.count = 0;
+    slot.entry.last = 0.0;
+    slot.entry.average = 0.0;
+    slot.entry.peak = 0.0;
+    slot.entry.allocs.count = slot.entry.allocs.bytes = 0;
+    slot.total = 0;
+    slot.count = 0;
+    slot.allocs = slot.entry.allocs;
+    slots.push_back(slot);
+    return slots.back();
+}
+
+void add(const char *name, bool gpu, int thread,
+         long long start, long long duration, const AllocStats &allocs) {
+    Lock lock(profile_lock());
+    Slot &slot = get_slot(name, gpu);
+    slot.total += duration;
+    slot.count++;
+    slot.allocs.count += allocs.count;
+    slot.allocs.bytes += allocs.bytes;
+    if (is_tracing && events.size() < MAX_EVENTS) {
+        Event event = { name, thread, start, duration };
+        events.push_back(event);
+    }
+}
+
+}
+
+bool Profile::enabled() {
+    return is_enabled.load(std::memory_order_relaxed);
+}
+
+void Profile::set_enabled(bool enabled) {
+    is_enabled = enabled || is_tracing;
+}
+
+void Profile::record(const char *name, long long start, long long end,
+                     const AllocStats &allocs) {
+    add(name, false, thread_id(), start, end - start, allocs);
+}
+
+void Profile::record_gpu(const char *name, long long start,
+                         long long duration) {
+    AllocStats allocs = { 0, 0 };
+    add(name, true, GPU_THREAD, start, duration, allocs);
+}
+
+void Profile::end_frame() {
+    Lock lock(profile_lock());
+    for (auto &slot : slots) {
+        ProfileEntry &e = slot.entry;
+        e.count = slot.count;
+        e.last = slot.total * 1e-3;
+        e.average += (e.last - e.average) * SMOOTHING;
+        if (e.last > e.peak)
+            e.peak = e.last;
+        e.allocs = slot.allocs;
+        slot.total = 0;
+        slot.count = 0;
+        slot.allocs.count = slot.allocs.bytes = 0;
+    }
+}
+
+void Profile::get(std::vector<ProfileEntry> &entries) {
+    Lock lock(profile_lock());
+    entries.clear();
+    for (auto &slot : slots)
+        entries.push_back(slot.entry);
+}
+
+bool Profile::tracing() {
+    return is_tracing;
+}
+
+void Profile::start_trace() {
+    Lock lock(profile_lock());
+    events.clear();
+    trace_start = Clock::micros();
+    is_tracing = true;
+    is_enabled = true;
+}
+
+std::string Profile::stop_trace() {
+    std::vector<Event> trace;
+    long long start;
+    {
+        Lock lock(profile_lock());
+        if (!is_tracing)
+            return std::string();
+        is_tracing = false;
+        trace.swap(events);
+        start = trace_start;
+    }
+
+    char name[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(name, sizeof(name), "/trace-%Y%m%d-%H%M%S.json",
+                  std::localtime(&now));
+    std::string path = CVar::get_string("path", "user", "user") + name;
+    std::FILE *fp = std::fopen(path.c_str(), "w");
+    if (!fp) {
+        Log::error("%s: could not write trace", path.c_str());
+        return std::string();
+    }
+    // Thread names make the GPU track easy to find.
+    std::fputs("{\"traceEvents\":[\n"
+               "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"tid\":0,\"args\":{\"name\":\"GPU\"}}", fp);
+    for (auto &event : trace) {
+        std::fprintf(
+            fp,
+            ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+            "\"tid\":%d,\"ts\":%lld,\"dur\":%lld}",
+            event.name, event.thread == GPU_THREAD ? "gpu" : "cpu",
+            event.thread, event.start - start, event.duration);
+    }
+    std::fputs("\n]}\n", fp);
+    bool ok = !std::ferror(fp);
+    if (std::fclose(fp) || !ok) {
+        Log::error("%s: could not write trace", path.c_str());
+        return std::string();
+    }
+    if (trace.size() >= MAX_EVENTS)
+        Log::warn("trace truncated to %zu events", trace.size());
+    return path;
+}
+
+}
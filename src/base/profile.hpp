@@ -0,0 +1,89 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_BASE_PROFILE_HPP
+#define LD_BASE_PROFILE_HPP
+#include "alloc.hpp"
+#include "clock.hpp"
+#include <string>
+#include <vector>
+namespace Base {
+
+/// Timing of one named scope, accumulated over a frame.
+struct ProfileEntry {
+    /// The scope name.
+    const char *name;
+    /// Whether the time was measured on the GPU.
+    bool gpu;
+    /// Number of times the scope ran during the last frame.
+    unsigned count;
+    /// Total time during the last frame, in milliseconds.
+    double last;
+    /// Smoothed time per frame, in milliseconds.
+    double average;
+    /// Maximum time in any frame, in milliseconds.
+    double peak;
+    /// Allocations during the last frame, if tracking is available.
+    AllocStats allocs;
+};
+
+/// Collects timings of named scopes.  Scope names must be string
+/// literals, since they are compared and stored by address.  All
+/// functions may be called from any thread.
+struct Profile {
+    /// Determine whether scopes are being timed.
+    static bool enabled();
+    /// Start or stop timing scopes.
+    static void set_enabled(bool enabled);
+
+    /// Record a scope which ran on the CPU between the given
+    /// timestamps, from Clock::micros().
+    static void record(const char *name, long long start, long long end,
+                       const AllocStats &allocs);
+    /// Record a GPU pass, which was submitted at the given timestamp
+    /// and took the given number of microseconds to execute.
+    static void record_gpu(const char *name, long long start,
+                           long long duration);
+    /// Mark the end of a frame.
+    static void end_frame();
+    /// Get the timings of all scopes, in the order first seen.
+    static void get(std::vector<ProfileEntry> &entries);
+
+    /// Determine whether a trace is being recorded.
+    static bool tracing();
+    /// Start recording a trace.  This also enables timing.
+    static void start_trace();
+    /// Stop recording a trace and write it to the user directory, in
+    /// the Chrome trace event format.  Returns the path written, or
+    /// an empty string on failure.
+    static std::string stop_trace();
+};
+
+/// Time a scope.  Does nothing if profiling is disabled when the
+/// scope is entered.
+class ProfileScope {
+    const char *m_name;
+    long long m_start;
+    AllocStats m_allocs;
+
+public:
+    explicit ProfileScope(const char *name)
+        : m_name(name), m_start(-1) {
+        if (Profile::enabled()) {
+            m_allocs = Alloc::thread_stats();
+            m_start = Clock::micros();
+        }
+    }
+    ProfileScope(const ProfileScope &) = delete;
+    ~ProfileScope() {
+        if (m_start >= 0) {
+            long long end = Clock::micros();
+            Profile::record(m_name, m_start, end,
+                            Alloc::thread_stats() - m_allocs);
+        }
+    }
+    ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
+}
+#endif
@@ -1,16 +1,36 @@
 /* Copyright 2013-2014 Dietrich Epp.
    This file is part of Dreamless.  Dreamless is licensed under the terms
    of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "clock.hpp"
+#include "cvar.hpp"
 #include "file.hpp"
+#include "opengl.hpp"
 #include "shader.hpp"
 #include "log.hpp"
+#include <cstdio>
+#include <cstring>
+#include <map>
 #include <stdexcept>
+#include <vector>
 #include <assert.h>
 namespace Base {
 
-/// Load a GLSL shader.  Returns 0 on failure.
-GLuint load_shader(const std::string &name, GLenum type) {
-    static const int MAX_SIZE = 1024 * 64;
+namespace {
+
+const int MAX_SIZE = 1024 * 64;
+
+// Libraries included by each shader, by shader name and type.
+std::map<std::pair<std::string, GLenum>, std::vector<std::string>>
+    shader_includes;
+
+}
+
+/// Read the source code for a GLSL shader.  Lines of the form
+/// #include "name" are replaced with the library shader/name.glsl.
+std::string read_shader(const std::string &name, GLenum type,
+                        std::string &source) {
+    static const char INCLUDE[] = "#include \"";
+    static const std::size_t INCLUDE_LEN = sizeof(INCLUDE) - 1;
     std::string path("shader/");
     path += name;
     switch (type) {
@@ -18,19 +38,80 @@ GLuint load_shader(const std::string &name, GLenum type) {
     case GL_FRAGMENT_SHADER: path += ".frag.glsl"; break;
     default: assert(0);
     }
+    Data data;
+    data.read(path, MAX_SIZE);
+
+    auto &includes = shader_includes[std::make_pair(name, type)];
+    includes.clear();
+    source.clear();
+    const char *ptr = static_cast<const char *>(data.ptr());
+    const char *end = ptr + data.size();
+    while (ptr != end) {
+        const char *nl = static_cast<const char *>(
+            std::memchr(ptr, '\n', end - ptr));
+        const char *eol = nl ? nl + 1 : end;
+        const char *quote;
+        if (static_cast<std::size_t>(eol - ptr) > INCLUDE_LEN &&
+            !std::memcmp(ptr, INCLUDE, INCLUDE_LEN) &&
+            (quote = static_cast<const char *>(std::memchr(
+                ptr + INCLUDE_LEN, '"', eol - ptr - INCLUDE_LEN)))) {
+            std::string lib(ptr + INCLUDE_LEN, quote);
+            Data libdata;
+            libdata.read("shader/" + lib + ".glsl", MAX_SIZE);
+            source.append(static_cast<const char *>(libdata.ptr()),
+                          libdata.size());
+            if (!source.empty() && source[source.size() - 1] != '\n')
+                source += '\n';
+            includes.push_back(std::move(lib));
+        } else {
+            source.append(ptr, eol);
+        }
+        ptr = eol;
+    }
+    if (source.size() > static_cast<std::size_t>(MAX_SIZE))
+        Log::abort("%s: shader too large", path.c_str());
+    return path;
+}
+
+bool shader_uses(const std::string &shader, GLenum type,
+                 const std::string &name) {
+    if (shader == name)
+        return true;
+    auto i = shader_includes.find(std::make_pair(shader, type));
+    if (i == shader_includes.end())
+        return false;
+    for (auto &lib : i->second) {
+        if (lib == name)
+            return true;
+    }
+    return false;
+}
 
+/// Compile a GLSL shader.  The preamble is inserted after the
+/// #version line.  Returns 0 on failure.
+GLuint load_shader(const std::string &path, const std::string &source,
+                   const std::string &preamble, GLenum type) {
     sg_opengl_checkerror("before load_shader");
 
-    Data data;
-    data.read(path, MAX_SIZE);
+    const char *darr[3];
+    GLint larr[3];
 
-    const char *darr[1];
-    GLint larr[1];
+    // Split the source after the #version line, if there is one.
+    const char *src = source.data();
+    std::size_t len = source.size(), pos = 0;
+    if (len >= 8 && !std::memcmp(src, "#version", 8)) {
+        const void *eol = std::memchr(src, '\n', len);
+        pos = eol ? static_cast<const char *>(eol) - src + 1 : len;
+    }
 
     GLuint shader = glCreateShader(type);
-    darr[0] = static_cast<const char *>(data.ptr());
-    larr[0] = static_cast<int>(data.size()); // See MAX_SIZE
-    glShaderSource(shader, 1, darr, larr);
+    darr[0] = src;
+    larr[0] = static_cast<int>(pos);
+    darr[1] = preamble.data();
+    larr[1] = static_cast<int>(preamble.size());
+    darr[2] = src + pos;
+    larr[2] = static_cast<int>(len - pos); // See MAX_SIZE
+    glShaderSource(shader, 3, darr, larr);
     glCompileShader(shader);
     GLint flag;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &flag);
@@ -52,6 +133,177 @@ GLuint load_shader(const std::string &name, GLenum type) {
     return 0;
 }
 
+namespace {
+
+// Uniform blocks in existence, declared in every shader.
+std::vector<UniformBlock *> uniform_blocks;
+
+// Macro definitions for every shader.
+std::vector<std::pair<std::string, int>> shader_defines;
+
+std::string define_text() {
+    std::string text;
+    for (auto &def : shader_defines) {
+        text += "#define ";
+        text += def.first;
+        text += ' ';
+        text += std::to_string(def.second);
+        text += '\n';
+    }
+    return text;
+}
+
+const char *const BLOCK_TYPE_NAME[3] = { "float", "vec2", "vec4" };
+
+}
+
+UniformBlock::UniformBlock(const char *name, GLuint binding,
+                           const BlockField *fields, std::size_t size)
+    : m_name(name), m_fields(fields), m_size(size), m_binding(binding),
+      m_buffer(0), m_data(size), m_serial(1) {
+    if (supported()) {
+        glGenBuffers(1, &m_buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+        glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_buffer);
+        sg_opengl_checkerror("UniformBlock");
+    }
+    uniform_blocks.push_back(this);
+}
+
+UniformBlock::~UniformBlock() {
+    for (auto i = uniform_blocks.begin(); i != uniform_blocks.end(); i++) {
+        if (*i == this) {
+            uniform_blocks.erase(i);
+            break;
+        }
+    }
+    if (m_buffer)
+        glDeleteBuffers(1, &m_buffer);
+}
+
+bool UniformBlock::supported() {
+    static int supported = -1;
+    if (supported < 0)
+        supported =
+            GLInfo::extension("GL_ARB_uniform_buffer_object") ? 1 : 0;
+    return supported != 0;
+}
+
+std::string UniformBlock::preamble() {
+    std::string text;
+    if (uniform_blocks.empty())
+        return text;
+    if (supported())
+        text += "#extension GL_ARB_uniform_buffer_object : require\n";
+    for (UniformBlock *block : uniform_blocks)
+        text += block->declaration();
+    return text;
+}
+
+void UniformBlock::bind_all(GLuint prog) {
+    for (UniformBlock *block : uniform_blocks)
+        block->bind(prog);
+}
+
+std::string UniformBlock::declaration() const {
+    std::string text, indent;
+    if (supported()) {
+        text += "layout(std140) uniform ";
+        text += m_name;
+        text += " {\n";
+        indent = "    ";
+    }
+    for (int i = 0; m_fields[i].name; i++) {
+        text += indent;
+        if (!supported())
+            text += "uniform ";
+        text += BLOCK_TYPE_NAME[static_cast<int>(m_fields[i].type)];
+        text += ' ';
+        text += m_fields[i].name;
+        text += ";\n";
+    }
+    if (supported())
+        text += "};\n";
+    return text;
+}
+
+void UniformBlock::bind(GLuint prog) {
+    if (supported()) {
+        GLuint index = glGetUniformBlockIndex(prog, m_name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(prog, index, m_binding);
+        return;
+    }
+
+    // Program names are reused, so replace any stale entry.
+    ProgramInfo *info = nullptr;
+    for (ProgramInfo &p : m_programs) {
+        if (p.prog == prog) {
+            info = &p;
+            break;
+        }
+    }
+    if (!info) {
+        m_programs.push_back(ProgramInfo());
+        info = &m_programs.back();
+        info->prog = prog;
+    }
+    info->serial = 0;
+    info->location.clear();
+    for (int i = 0; m_fields[i].name; i++)
+        info->location.push_back(
+            glGetUniformLocation(prog, m_fields[i].name));
+}
+
+void UniformBlock::update(const void *data) {
+    if (!std::memcmp(m_data.data(), data, m_size))
+        return;
+    std::memcpy(m_data.data(), data, m_size);
+    m_serial++;
+    if (m_buffer) {
+        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, m_size, data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+}
+
+void UniformBlock::apply(GLuint prog) {
+    if (m_buffer)
+        return;
+    for (ProgramInfo &p : m_programs) {
+        if (p.prog != prog)
+            continue;
+        if (p.serial == m_serial)
+            return;
+        p.serial = m_serial;
+        for (int i = 0; m_fields[i].name; i++) {
+            GLint loc = p.location[i];
+            if (loc < 0)
+                continue;
+            const GLfloat *v = reinterpret_cast<const GLfloat *>(
+                m_data.data() + m_fields[i].offset);
+            switch (m_fields[i].type) {
+            case BlockType::FLOAT: glUniform1fv(loc, 1, v); break;
+            case BlockType::VEC2:  glUniform2fv(loc, 1, v); break;
+            case BlockType::VEC4:  glUniform4fv(loc, 1, v); break;
+            }
+        }
+        return;
+    }
+}
+
+void set_shader_define(const std::string &name, int value) {
+    for (auto &def : shader_defines) {
+        if (def.first == name) {
+            def.second = value;
+            return;
+        }
+    }
+    shader_defines.emplace_back(name, value);
+}
+
 /// Link a shader program.  Returns false on failure.
 bool link_program(GLuint prog, std::string &name) {
     GLint flag, loglen;
@@ -92,17 +344,173 @@ void get_attributes(GLuint prog, void *object,
     }
 }
 
+namespace {
+
+// Program binaries are cached in the user directory.  The cache key
+// is a hash of the shader source code and the OpenGL driver strings,
+// so changing either one invalidates the cache.
+const char CACHE_MAGIC[4] = { 'D', 'L', 'P', 'B' };
+const unsigned CACHE_VERSION = 1;
+const long MAX_CACHE_SIZE = 1024 * 1024 * 4;
+
+struct CacheHeader {
+    char magic[4];
+    unsigned version;
+    unsigned long long key;
+    unsigned format;
+    unsigned length;
+};
+
+// Determine whether program binaries can be cached.
+bool cache_enabled() {
+    static int enabled = -1;
+    if (enabled < 0) {
+        enabled = 0;
+        if (CVar::get_bool("graphics", "shadercache", true) &&
+            (GLInfo::version(4, 1) ||
+             GLInfo::extension("GL_ARB_get_program_binary"))) {
+            GLint nformats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nformats);
+            enabled = nformats > 0;
+        }
+    }
+    return enabled != 0;
+}
+
+void hash_bytes(unsigned long long &hash, const void *ptr,
+                std::size_t size) {
+    const unsigned char *p = static_cast<const unsigned char *>(ptr);
+    for (std::size_t i = 0; i < size; i++)
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    hash = (hash ^ 0xff) * 1099511628211ull;
+}
+
+unsigned long long cache_key(const std::string &vertex,
+                             const std::string &fragment,
+                             const std::string &preamble) {
+    static const GLenum STRINGS[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    unsigned long long hash = 14695981039346656037ull;
+    hash_bytes(hash, preamble.data(), preamble.size());
+    hash_bytes(hash, vertex.data(), vertex.size());
+    hash_bytes(hash, fragment.data(), fragment.size());
+    for (GLenum name : STRINGS) {
+        const char *str =
+            reinterpret_cast<const char *>(glGetString(name));
+        if (str)
+            hash_bytes(hash, str, std::strlen(str));
+    }
+    return hash;
+}
+
+std::string cache_path(const std::string &vertexshader,
+                       const std::string &fragmentshader) {
+    return CVar::get_string("path", "user", "user") + "/shader-" +
+        vertexshader + "-" + fragmentshader + ".bin";
+}
+
+// Create a program from a cached binary.  Returns 0 if the cache is
+// missing, out of date, or rejected by the driver.
+GLuint cache_load(const std::string &path, unsigned long long key) {
+    std::FILE *fp = std::fopen(path.c_str(), "rb");
+    if (!fp)
+        return 0;
+    CacheHeader head;
+    std::vector<char> binary;
+    bool ok = std::fread(&head, sizeof(head), 1, fp) == 1 &&
+        !std::memcmp(head.magic, CACHE_MAGIC, 4) &&
+        head.version == CACHE_VERSION && head.key == key &&
+        head.length > 0 && head.length <= MAX_CACHE_SIZE;
+    if (ok) {
+        binary.resize(head.length);
+        ok = std::fread(binary.data(), head.length, 1, fp) == 1;
+    }
+    std::fclose(fp);
+    if (!ok)
+        return 0;
+
+    GLuint prog = glCreateProgram();
+    glProgramBinary(prog, head.format, binary.data(),
+                    static_cast<GLsizei>(head.length));
+    GLint flag;
+    glGetProgramiv(prog, GL_LINK_STATUS, &flag);
+    if (!flag) {
+        Log::info("%s: cached program rejected by driver", path.c_str());
+        glDeleteProgram(prog);
+        return 0;
+    }
+    return prog;
+}
+
+// Save a linked program's binary to the cache.
+void cache_store(const std::string &path, unsigned long long key,
+                 GLuint prog) {
+    GLint length = 0;
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0 || length > MAX_CACHE_SIZE)
+        return;
+    std::vector<char> binary(length);
+    CacheHeader head;
+    std::memcpy(head.magic, CACHE_MAGIC, 4);
+    head.version = CACHE_VERSION;
+    head.key = key;
+    GLenum format;
+    glGetProgramBinary(prog, length, &length, &format, binary.data());
+    head.format = format;
+    head.length = static_cast<unsigned>(length);
+
+    std::FILE *fp = nullptr;
+    if (make_directory(path.substr(0, path.rfind('/'))))
+        fp = std::fopen(path.c_str(), "wb");
+    if (!fp) {
+        Log::warn("%s: could not write shader cache", path.c_str());
+        return;
+    }
+    bool ok = std::fwrite(&head, sizeof(head), 1, fp) == 1 &&
+        std::fwrite(binary.data(), head.length, 1, fp) == 1;
+    if (std::fclose(fp) || !ok) {
+        Log::warn("%s: could not write shader cache", path.c_str());
+        std::remove(path.c_str());
+    }
+}
+
+}
+
 GLuint load_program(const std::string &vertexshader,
                     const std::string &fragmentshader,
                     const ShaderField *uniforms,
                     const ShaderField *attributes,
                     void *object) {
+    long long start = Clock::micros();
     std::string name = vertexshader + ", " + fragmentshader;
-    GLuint vertex = load_shader(vertexshader, GL_VERTEX_SHADER);
+    std::string vsource, fsource;
+    std::string vpath = read_shader(vertexshader, GL_VERTEX_SHADER, vsource);
+    std::string fpath =
+        read_shader(fragmentshader, GL_FRAGMENT_SHADER, fsource);
+    std::string preamble = define_text() + UniformBlock::preamble();
+
+    bool cache = cache_enabled();
+    unsigned long long key = 0;
+    std::string cpath;
+    if (cache) {
+        key = cache_key(vsource, fsource, preamble);
+        cpath = cache_path(vertexshader, fragmentshader);
+        GLuint prog = cache_load(cpath, key);
+        if (prog) {
+            UniformBlock::bind_all(prog);
+            get_uniforms(prog, object, uniforms);
+            get_attributes(prog, object, attributes);
+            Log::info("%s: loaded from cache in %.2f ms", name.c_str(),
+                      (Clock::micros() - start) * 1e-3);
+            return prog;
+        }
+    }
+
+    GLuint vertex = load_shader(vpath, vsource, preamble, GL_VERTEX_SHADER);
     if (vertex == 0) {
         return 0;
     }
-    GLuint fragment = load_shader(fragmentshader, GL_FRAGMENT_SHADER);
+    GLuint fragment =
+        load_shader(fpath, fsource, preamble, GL_FRAGMENT_SHADER);
     if (fragment == 0) {
         glDeleteShader(vertex);
         return 0;
@@ -112,12 +520,20 @@ GLuint load_program(const std::string &vertexshader,
     glAttachShader(prog, fragment);
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+    if (cache)
+        glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                            GL_TRUE);
     if (!link_program(prog, name)) {
         glDeleteProgram(prog);
         return 0;
     }
+    UniformBlock::bind_all(prog);
     get_uniforms(prog, object, uniforms);
     get_attributes(prog, object, attributes);
+    Log::info("%s: compiled in %.2f ms", name.c_str(),
+              (Clock::micros() - start) * 1e-3);
+    if (cache)
+        cache_store(cpath, key, prog);
     return prog;
 }
 
@@ -6,6 +6,7 @@
 #include "sg/opengl.h"
 #include <cstddef>
 #include <string>
+#include <vector>
 namespace Base {
 
 /// A field in an object which stores program attributes and uniform indexes.
@@ -17,6 +18,83 @@ struct ShaderField {
     std::size_t offset;
 };
 
+/// Types of fields in a uniform block.
+enum class BlockType {
+    FLOAT, VEC2, VEC4
+};
+
+/// A field in a uniform block.
+struct BlockField {
+    /// The name of the uniform.
+    const char *name;
+
+    /// The type of the uniform.
+    BlockType type;
+
+    /// The offset of the field in the block's structure, which must
+    /// use the std140 layout.
+    std::size_t offset;
+};
+
+/// A block of uniforms shared by every shader program.  Every shader
+/// has a declaration of the block inserted after its #version line.
+/// If uniform buffer objects are supported, the block is stored in
+/// one buffer object for all programs.  Otherwise, the fields are
+/// declared as ordinary uniforms and set on each program by apply().
+class UniformBlock {
+private:
+    struct ProgramInfo {
+        GLuint prog;
+        unsigned serial;
+        std::vector<GLint> location;
+    };
+
+    const char *m_name;
+    const BlockField *m_fields;
+    std::size_t m_size;
+    GLuint m_binding;
+    GLuint m_buffer;
+    std::vector<unsigned char> m_data;
+    unsigned m_serial;
+    std::vector<ProgramInfo> m_programs;
+
+public:
+    /// Create a uniform block.  The field list ends with a null name.
+    /// The block must be created before any programs which use it.
+    UniformBlock(const char *name, GLuint binding,
+                 const BlockField *fields, std::size_t size);
+    UniformBlock(const UniformBlock &) = delete;
+    ~UniformBlock();
+    UniformBlock &operator=(const UniformBlock &) = delete;
+
+    /// Determine whether uniform buffer objects are supported.
+    static bool supported();
+    /// Get the GLSL declarations to insert in every shader.
+    static std::string preamble();
+    /// Bind every uniform block to a newly linked program.
+    static void bind_all(GLuint prog);
+
+    /// Set the contents of the block.
+    void update(const void *data);
+    /// Set the uniforms of a program which uses the block.  This must
+    /// be called after glUseProgram, and only does work if uniform
+    /// buffer objects are unsupported.
+    void apply(GLuint prog);
+
+private:
+    std::string declaration() const;
+    void bind(GLuint prog);
+};
+
+/// Define a preprocessor macro in every shader compiled after this
+/// call.
+void set_shader_define(const std::string &name, int value);
+
+/// Determine whether a shader is the named shader or includes the
+/// named library.  Only shaders which have been loaded are known.
+bool shader_uses(const std::string &shader, GLenum type,
+                 const std::string &name);
+
 /// Load an OpenGL shader program.  Returns 0 on failure.
 GLuint load_program(const std::string &vertexshader,
                     const std::string &fragmentshader,
@@ -30,6 +108,8 @@ class Program {
 private:
     GLuint prog_;
     T fields_;
+    std::string vertexshader_;
+    std::string fragmentshader_;
 
 public:
     Program(const std::string &vertexshader,
@@ -42,12 +122,22 @@ public:
     const T *operator->() const { return &fields_; }
     /// Get the program object.
     GLuint prog() const { return prog_; }
+    /// Determine whether the program uses the named shader or
+    /// library.
+    bool uses(const std::string &name) const {
+        return shader_uses(vertexshader_, GL_VERTEX_SHADER, name) ||
+            shader_uses(fragmentshader_, GL_FRAGMENT_SHADER, name);
+    }
+    /// Recompile the program from source.  On failure, the old
+    /// program is kept and false is returned.
+    bool reload();
 };
 
 template<class T>
 Program<T>::Program(const std::string &vertexshader,
                     const std::string &fragmentshader)
-    : prog_(0), fields_() {
+    : prog_(0), fields_(),
+      vertexshader_(vertexshader), fragmentshader_(fragmentshader) {
     prog_ = load_program(
         vertexshader, fragmentshader,
         T::UNIFORMS, T::ATTRIBUTES,
@@ -59,5 +149,20 @@ Program<T>::~Program() {
     glDeleteProgram(prog_);
 }
 
+template<class T>
+bool Program<T>::reload() {
+    T fields = T();
+    GLuint prog = load_program(
+        vertexshader_, fragmentshader_,
+        T::UNIFORMS, T::ATTRIBUTES,
+        &fields);
+    if (!prog)
+        return false;
+    glDeleteProgram(prog_);
+    prog_ = prog;
+    fields_ = fields;
+    return true;
+}
+
 }
 #endif
@@ -11,6 +11,7 @@
 #include <vector>
 #include <string>
 namespace Base {
+class AssetLoader;
 
 /// Orthogonal orientations for 2D sprites.
 enum class Orientation {
@@ -24,6 +25,11 @@ Orientation operator*(Orientation x, Orientation y);
 /// A 2D integer rectangle.
 struct SpriteRect {
     short x, y, w, h, cx, cy;
+    /// The sprite sheet page containing the sprite.
+    short page;
+    /// If true, the sprite is transposed in the sprite sheet, so its
+    /// width runs along the texture's Y axis.
+    bool rotated;
 };
 
 /// A sprite to add to a sprite sheet.
@@ -35,31 +41,86 @@ struct Sprite {
 /// A sprite sheet.
 class SpriteSheet {
 private:
+    struct Build;
+
     std::vector<SpriteRect> m_sprites;
-    Texture m_texture;
+    std::vector<Texture> m_texture;
 
 public:
     SpriteSheet();
     SpriteSheet(const std::string &dirname, const Sprite *sprites);
+    /// Load a sprite sheet baked by gensprite.py, or pack the sprites
+    /// at runtime if the baked sheet is missing or out of date.
+    SpriteSheet(const std::string &dirname, const Sprite *sprites,
+                const std::string &atlas);
     SpriteSheet(const SpriteSheet &other) = delete;
     SpriteSheet(SpriteSheet &&other) = delete;
     ~SpriteSheet();
     SpriteSheet &operator=(const SpriteSheet &other) = delete;
     SpriteSheet &operator=(SpriteSheet &&other) = delete;
 
-    /// Get the texture object containing the sprites.
-    GLuint texture() const { return m_texture.tex; }
-    /// Get the factor to convert pixel coordinates to texture coordinates.
-    const float *texscale() const { return m_texture.scale; }
+    /// Load the sprite sheet using an asset loader.  Images are
+    /// decoded and packed on worker threads, and the sprite sheet is
+    /// valid after the loader finishes.  If the atlas name is empty,
+    /// the sprites are always packed at runtime.
+    void load(AssetLoader &loader, const std::string &dirname,
+              const Sprite *sprites, const std::string &atlas);
+
+    /// Get the number of pages.
+    int pages() const { return static_cast<int>(m_texture.size()); }
+    /// Get the texture object containing the sprites on a page.
+    GLuint texture(int page) const { return m_texture[page].tex; }
+    /// Get the factor to convert pixel coordinates to texture
+    /// coordinates on a page.
+    const float *texscale(int page) const { return m_texture[page].scale; }
     /// Get the rectangle containing the given sprite.
     SpriteRect get(int index) const { return m_sprites.at(index); }
+
+private:
+    static std::vector<std::string> list_images(
+        const std::string &dirname, Build &build);
+    static void pack_images(Build &build);
+    static bool read_atlas(const std::string &atlas, Build &build);
+    void pack(const std::string &dirname, Build &build);
+    void upload(Build &build, std::vector<Image> &pages);
 };
 
-// Array of sprite rectangles with texture coordinates.
-// Draw with GL_TRIANGLES.
+/// A run of sprites in a sprite array which use the same page.
+struct SpriteRun {
+    /// The sprite sheet page.
+    int page;
+    /// The index of the first vertex.
+    unsigned first;
+    /// The number of vertexes.
+    unsigned count;
+};
+
+// Array of sprite rectangles with texture coordinates.  Sprites are
+// sorted by depth when uploaded, and sprites with the same depth keep
+// the order they were added.  A new run starts wherever the sprite
+// sheet page changes.  Draw each run with GL_TRIANGLES.
 class SpriteArray {
 private:
+    struct Quad {
+        unsigned key;
+        unsigned short page;
+        short vert[6][4];
+    };
+
+    struct SortKey {
+        unsigned key;
+        unsigned index;
+    };
+
+    std::vector<Quad> m_quad;
+    std::vector<SortKey> m_order;
+    std::vector<SortKey> m_temp;
+    std::vector<SpriteRun> m_run;
     Array<short[4]> m_array;
+    unsigned m_size;
+    bool m_dirty;
+
+    short (*insert(int page, int z))[4];
 
 public:
     SpriteArray();
@@ -75,14 +136,19 @@ public:
     void add(SpriteRect tex, int x, int y);
     /// Add a sprite (tex) at the given lower-left coordinate.
     void add(SpriteRect tex, int x, int y, Orientation orient);
-    /// Upload the array data.
+    /// Add a sprite (tex) at the given lower-left coordinate, with the
+    /// given depth.  Sprites with greater depth are drawn on top.
+    void add(SpriteRect tex, int x, int y, Orientation orient, int z);
+    /// Sort and upload the array data.
     void upload(GLuint usage);
-    /// Bind the OpenGL attribute.
-    void set_attrib(GLint attrib);
+    /// Get the runs of sprites which share a page, in drawing order.
+    const std::vector<SpriteRun> &runs() const { return m_run; }
+    /// Bind the OpenGL attribute for the sprites.
+    void set_attrib(GLint attrib) { m_array.set_attrib(attrib); }
     /// Get the number of vertexes.
-    unsigned size() const { return m_array.size(); }
+    unsigned size() const { return m_size; }
     /// Determine whether the array is empty.
-    bool empty() const { return m_array.empty(); }
+    bool empty() const { return m_size == 0; }
 };
 
 }
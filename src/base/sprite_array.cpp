@@ -2,50 +2,129 @@
    This file is part of Dreamless.  Dreamless is licensed under the terms
    of the 2-clause BSD license.  For more information, see LICENSE.txt. */
 #include "sprite.hpp"
+#include <cstring>
+#include <limits>
 namespace Base {
 
+namespace {
+
+// Set the texture coordinates for the two triangles of a sprite.
+void set_texcoords(short (*data)[4], const SpriteRect &tex) {
+    // Corners: lower left, lower right, upper left, upper right.
+    short t[4][2];
+    if (!tex.rotated) {
+        short tx0 = tex.x, tx1 = tex.x + tex.w;
+        short ty1 = tex.y, ty0 = tex.y + tex.h;
+        t[0][0] = tx0; t[0][1] = ty0;
+        t[1][0] = tx1; t[1][1] = ty0;
+        t[2][0] = tx0; t[2][1] = ty1;
+        t[3][0] = tx1; t[3][1] = ty1;
+    } else {
+        // Image pixel (u, v) is stored at (x + v, y + u).
+        short tu0 = tex.y, tu1 = tex.y + tex.w;
+        short tv0 = tex.x, tv1 = tex.x + tex.h;
+        t[0][0] = tv1; t[0][1] = tu0;
+        t[1][0] = tv1; t[1][1] = tu1;
+        t[2][0] = tv0; t[2][1] = tu0;
+        t[3][0] = tv0; t[3][1] = tu1;
+    }
+    static const int CORNER[6] = { 0, 1, 2, 2, 1, 3 };
+    for (int i = 0; i < 6; i++) {
+        data[i][2] = t[CORNER[i]][0];
+        data[i][3] = t[CORNER[i]][1];
+    }
+}
+
+// Stable LSD radix sort by key.  Digits which are the same in every
+// key are skipped, so a layer with one depth is not moved at all.
+template<class T>
+void radix_sort(std::vector<T> &data, std::vector<T> &temp) {
+    std::size_t n = data.size();
+    if (n < 2)
+        return;
+    temp.resize(n);
+    for (int shift = 0; shift < 32; shift += 8) {
+        std::size_t count[256] = { 0 };
+        for (std::size_t i = 0; i < n; i++)
+            count[(data[i].key >> shift) & 255]++;
+        if (count[(data[0].key >> shift) & 255] == n)
+            continue;
+        std::size_t pos = 0;
+        for (int i = 0; i < 256; i++) {
+            std::size_t c = count[i];
+            count[i] = pos;
+            pos += c;
+        }
+        for (std::size_t i = 0; i < n; i++)
+            temp[count[(data[i].key >> shift) & 255]++] = data[i];
+        data.swap(temp);
+    }
+}
+
+}
+
 SpriteArray::SpriteArray()
+    : m_size(0), m_dirty(true)
 { }
 
 SpriteArray::SpriteArray(SpriteArray &&other)
-    : m_array(std::move(other.m_array))
-{ }
+    : m_quad(std::move(other.m_quad)), m_order(std::move(other.m_order)),
+      m_temp(std::move(other.m_temp)), m_run(std::move(other.m_run)),
+      m_array(std::move(other.m_array)), m_size(other.m_size),
+      m_dirty(other.m_dirty) {
+    other.m_size = 0;
+    other.m_dirty = true;
+}
 
 SpriteArray::~SpriteArray()
 { }
 
+short (*SpriteArray::insert(int page, int z))[4] {
+    if (page < 0 || page > std::numeric_limits<unsigned short>::max())
+        sg_sys_abort("invalid sprite page");
+    if (z < std::numeric_limits<short>::min() ||
+        z > std::numeric_limits<short>::max())
+        sg_sys_abort("invalid sprite depth");
+    // The key sorts by depth only, so sprites at the same depth stay
+    // in the order they were added, even across pages.
+    Quad quad;
+    quad.key = static_cast<unsigned>(z + 0x8000);
+    quad.page = static_cast<unsigned short>(page);
+    m_quad.push_back(quad);
+    m_size += 6;
+    m_dirty = true;
+    return m_quad.back().vert;
+}
+
 void SpriteArray::clear() {
-    m_array.clear();
+    m_quad.clear();
+    m_size = 0;
+    m_dirty = true;
 }
 
 void SpriteArray::add(SpriteRect tex, int x, int y) {
-    short (*data)[4] = m_array.insert(6);
+    short (*data)[4] = insert(tex.page, 0);
+    set_texcoords(data, tex);
 
-    short tx0 = tex.x, tx1 = tex.x + tex.w;
-    short ty1 = tex.y, ty0 = tex.y + tex.h;
     short vx0 = x, vx1 = x + tex.w;
     short vy0 = y, vy1 = y + tex.h;
 
-    data[0][0] = vx0; data[0][1] = vy0; data[0][2] = tx0; data[0][3] = ty0;
-    data[1][0] = vx1; data[1][1] = vy0; data[1][2] = tx1; data[1][3] = ty0;
-    data[2][0] = vx0; data[2][1] = vy1; data[2][2] = tx0; data[2][3] = ty1;
-    data[3][0] = vx0; data[3][1] = vy1; data[3][2] = tx0; data[3][3] = ty1;
-    data[4][0] = vx1; data[4][1] = vy0; data[4][2] = tx1; data[4][3] = ty0;
-    data[5][0] = vx1; data[5][1] = vy1; data[5][2] = tx1; data[5][3] = ty1;
+    data[0][0] = vx0; data[0][1] = vy0;
+    data[1][0] = vx1; data[1][1] = vy0;
+    data[2][0] = vx0; data[2][1] = vy1;
+    data[3][0] = vx0; data[3][1] = vy1;
+    data[4][0] = vx1; data[4][1] = vy0;
+    data[5][0] = vx1; data[5][1] = vy1;
 }
 
 void SpriteArray::add(SpriteRect tex, int x, int y, Orientation orient) {
-    short (*data)[4] = m_array.insert(6);
-
-    short tx0 = tex.x, tx1 = tex.x + tex.w;
-    short ty1 = tex.y, ty0 = tex.y + tex.h;
+    add(tex, x, y, orient, 0);
+}
 
-    data[0][2] = tx0; data[0][3] = ty0;
-    data[1][2] = tx1; data[1][3] = ty0;
-    data[2][2] = tx0; data[2][3] = ty1;
-    data[3][2] = tx0; data[3][3] = ty1;
-    data[4][2] = tx1; data[4][3] = ty0;
-    data[5][2] = tx1; data[5][3] = ty1;
+void SpriteArray::add(SpriteRect tex, int x, int y, Orientation orient,
+                      int z) {
+    short (*data)[4] = insert(tex.page, z);
+    set_texcoords(data, tex);
 
     short rx0 = -tex.cx, rx1 = tex.w - tex.cx;
     short ry0 = -tex.cy, ry1 = tex.h - tex.cy;
@@ -123,11 +202,34 @@ void SpriteArray::add(SpriteRect tex, int x, int y, Orientation orient) {
 }
 
 void SpriteArray::upload(GLuint usage) {
-    m_array.upload(usage);
-}
+    if (!m_dirty)
+        return;
+    m_dirty = false;
+
+    std::size_t n = m_quad.size();
+    m_order.resize(n);
+    for (std::size_t i = 0; i < n; i++) {
+        m_order[i].key = m_quad[i].key;
+        m_order[i].index = static_cast<unsigned>(i);
+    }
+    radix_sort(m_order, m_temp);
 
-void SpriteArray::set_attrib(GLint attrib) {
-    m_array.set_attrib(attrib);
+    m_array.clear();
+    m_run.clear();
+    if (n > 0) {
+        short (*data)[4] = m_array.insert(n * 6);
+        for (std::size_t i = 0; i < n; i++) {
+            const Quad &quad = m_quad[m_order[i].index];
+            int page = quad.page;
+            if (m_run.empty() || m_run.back().page != page) {
+                SpriteRun run = { page, static_cast<unsigned>(i * 6), 0 };
+                m_run.push_back(run);
+            }
+            m_run.back().count += 6;
+            std::memcpy(data + i * 6, quad.vert, sizeof(quad.vert));
+        }
+    }
+    m_array.upload(usage);
 }
 
 }
@@ -3,45 +3,159 @@
    of the 2-clause BSD license.  For more information, see LICENSE.txt. */
 #include "sg/opengl.h"
 #include "sprite.hpp"
+#include "asset.hpp"
 #include "pack.hpp"
 #include "image.hpp"
 #include "log.hpp"
+#include "file.hpp"
+#include <cstring>
+#include <memory>
 #include <unordered_map>
 #include <string>
 namespace Base {
 
+namespace {
+
+// Maximum size of a sprite sheet page.
+const int MAX_PAGE_SIZE = 512;
+
+// Little-endian fields in baked sprite sheets.
+unsigned read_u32(const unsigned char *p) {
+    return static_cast<unsigned>(p[0]) |
+        (static_cast<unsigned>(p[1]) << 8) |
+        (static_cast<unsigned>(p[2]) << 16) |
+        (static_cast<unsigned>(p[3]) << 24);
+}
+
+unsigned read_u16(const unsigned char *p) {
+    return static_cast<unsigned>(p[0]) | (static_cast<unsigned>(p[1]) << 8);
+}
+
+short read_i16(const unsigned char *p) {
+    return static_cast<short>(read_u16(p));
+}
+
+}
+
 SpriteSheet::SpriteSheet()
     : m_sprites(), m_texture()
 { }
 
-SpriteSheet::SpriteSheet(const std::string &dirname, const Sprite *sprites)
-    : m_sprites(), m_texture() {
+// Sprite sheet data which is built on worker threads.
+struct SpriteSheet::Build {
+    const Sprite *sprites;
+    std::size_t count;
+    // Source images, or baked pages.
     std::vector<Image> images;
+    // The source image for each sprite.
     std::vector<std::size_t> spriteimages;
-    std::size_t count = 0;
-
-    {
-        std::string dirpath(dirname);
-        if (!dirpath.empty())
-            dirpath += '/';
-        std::unordered_map<std::string, std::size_t> imagenames;
-        for (int i = 0; sprites[i].name; i++) {
-            count++;
-            std::string name(sprites[i].name);
-            auto x = imagenames.insert(
-                std::unordered_map<std::string, std::size_t>::value_type(
-                    name, images.size()));
-            if (x.second) {
-                std::string path = dirpath;
-                path += name;
-                Image image;
-                image.load(path);
-                images.push_back(std::move(image));
-            }
-            spriteimages.push_back(x.first->second);
+    // The expected size of each baked page.
+    std::vector<Packing::Size> pagesizes;
+    std::vector<SpriteRect> rects;
+    std::vector<Image> pages;
+};
+
+SpriteSheet::SpriteSheet(const std::string &dirname, const Sprite *sprites)
+    : m_sprites(), m_texture() {
+    AssetLoader loader("sprites");
+    load(loader, dirname, sprites, std::string());
+    loader.finish();
+}
+
+SpriteSheet::SpriteSheet(const std::string &dirname, const Sprite *sprites,
+                         const std::string &atlas)
+    : m_sprites(), m_texture() {
+    AssetLoader loader("sprites");
+    load(loader, dirname, sprites, atlas);
+    loader.finish();
+}
+
+SpriteSheet::~SpriteSheet()
+{ }
+
+void SpriteSheet::load(AssetLoader &loader, const std::string &dirname,
+                       const Sprite *sprites, const std::string &atlas) {
+    std::shared_ptr<Build> build(new Build);
+    build->sprites = sprites;
+    build->count = 0;
+    while (sprites[build->count].name)
+        build->count++;
+
+    if (!atlas.empty() && read_atlas(atlas, *build)) {
+        std::size_t npages = build->pagesizes.size();
+        build->images.resize(npages);
+        for (std::size_t i = 0; i < npages; i++) {
+            loader.image(&build->images[i],
+                         atlas + '.' + std::to_string(i));
+            loader.process([build, i]() {
+                build->images[i].premultiply();
+            });
         }
+        loader.upload([this, build, dirname, atlas]() {
+            auto &b = *build;
+            for (std::size_t i = 0; i < b.images.size(); i++) {
+                if (b.images[i]->iwidth != b.pagesizes[i].width ||
+                    b.images[i]->iheight != b.pagesizes[i].height) {
+                    Log::warn("%s.%zu: page size mismatch",
+                              atlas.c_str(), i);
+                    pack(dirname, b);
+                    return;
+                }
+            }
+            Log::info("Loaded %zu sprites in %zu baked pages",
+                      b.count, b.images.size());
+            upload(b, b.images);
+        });
+        return;
     }
 
+    auto paths = list_images(dirname, *build);
+    build->images.resize(paths.size());
+    for (std::size_t i = 0; i < paths.size(); i++)
+        loader.image(&build->images[i], paths[i]);
+    loader.process([build]() {
+        pack_images(*build);
+    });
+    loader.upload([this, build]() {
+        upload(*build, build->pages);
+    });
+}
+
+std::vector<std::string> SpriteSheet::list_images(
+    const std::string &dirname, Build &build) {
+    std::vector<std::string> paths;
+    std::string dirpath(dirname);
+    if (!dirpath.empty())
+        dirpath += '/';
+    std::unordered_map<std::string, std::size_t> imagenames;
+    build.spriteimages.clear();
+    for (std::size_t i = 0; i < build.count; i++) {
+        std::string name(build.sprites[i].name);
+        auto x = imagenames.insert(
+            std::unordered_map<std::string, std::size_t>::value_type(
+                name, paths.size()));
+        if (x.second)
+            paths.push_back(dirpath + name);
+        build.spriteimages.push_back(x.first->second);
+    }
+    return paths;
+}
+
+void SpriteSheet::pack(const std::string &dirname, Build &build) {
+    auto paths = list_images(dirname, build);
+    build.images.clear();
+    build.images.resize(paths.size());
+    for (std::size_t i = 0; i < paths.size(); i++)
+        build.images[i].load(paths[i]);
+    pack_images(build);
+    upload(build, build.pages);
+}
+
+void SpriteSheet::pack_images(Build &build) {
+    auto &images = build.images;
+    const Sprite *sprites = build.sprites;
+    std::size_t count = build.count;
+
     std::vector<Packing::Size> imagesizes;
     imagesizes.reserve(images.size());
     for (auto &image : images) {
@@ -49,39 +163,145 @@ SpriteSheet::SpriteSheet(const std::string &dirname, const Sprite *sprites)
         imagesizes.push_back(sz);
     }
 
-    Packing packing = Packing::pack(imagesizes);
+    Packing packing = Packing::pack(imagesizes, MAX_PAGE_SIZE, true);
 
-    Log::info("Packing %zu sprites into a %dx%d sheet",
-              count, packing.packsize.width, packing.packsize.height);
+    Log::info("Packing %zu sprites into %zu pages",
+              count, packing.pages.size());
+    for (std::size_t i = 0; i < packing.pages.size(); i++) {
+        auto &page = packing.pages[i];
+        double area = static_cast<double>(page.size.width) *
+            static_cast<double>(page.size.height);
+        Log::info("Sprite page %zu: %dx%d, %.1f%% occupied",
+                  i, page.size.width, page.size.height,
+                  100.0 * static_cast<double>(page.used) / area);
+    }
 
-    m_sprites.reserve(count);
+    build.rects.clear();
+    build.rects.reserve(count);
     for (std::size_t i = 0; i < count; i++) {
-        auto loc = packing.locations[spriteimages[i]];
+        auto loc = packing.locations[build.spriteimages[i]];
         SpriteRect rect;
-        rect.x = sprites[i].x + loc.x;
-        rect.y = sprites[i].y + loc.y;
+        if (loc.rotated) {
+            rect.x = sprites[i].y + loc.x;
+            rect.y = sprites[i].x + loc.y;
+        } else {
+            rect.x = sprites[i].x + loc.x;
+            rect.y = sprites[i].y + loc.y;
+        }
         rect.w = sprites[i].w;
         rect.h = sprites[i].h;
         rect.cx = sprites[i].cx;
         rect.cy = sprites[i].cy;
-        m_sprites.push_back(rect);
+        rect.page = static_cast<short>(loc.page);
+        rect.rotated = loc.rotated;
+        build.rects.push_back(rect);
     }
 
-    Image tileimage;
-    tileimage.set(SG_RGBA, packing.packsize.width, packing.packsize.height);
-    tileimage.calloc();
-
-    for (std::size_t i = 0; i < images.size(); i++) {
-        tileimage.copy_from(
-            images[i],
-            packing.locations[i].x,
-            packing.locations[i].y);
+    build.pages.clear();
+    for (std::size_t page = 0; page < packing.pages.size(); page++) {
+        auto &size = packing.pages[page].size;
+        Image pageimage;
+        pageimage.set(SG_RGBA, size.width, size.height);
+        pageimage.calloc();
+        for (std::size_t i = 0; i < images.size(); i++) {
+            auto &loc = packing.locations[i];
+            if (loc.page != static_cast<int>(page))
+                continue;
+            if (loc.rotated)
+                pageimage.copy_from_transposed(images[i], loc.x, loc.y);
+            else
+                pageimage.copy_from(images[i], loc.x, loc.y);
+        }
+        // Sprites are drawn with premultiplied alpha blending.
+        pageimage.premultiply();
+        build.pages.push_back(std::move(pageimage));
     }
+}
 
-    m_texture = Texture::load(tileimage);
+void SpriteSheet::upload(Build &build, std::vector<Image> &pages) {
+    m_texture.clear();
+    for (auto &page : pages)
+        m_texture.push_back(Texture::load(page));
+    m_sprites = std::move(build.rects);
 }
 
-SpriteSheet::~SpriteSheet()
-{ }
+bool SpriteSheet::read_atlas(const std::string &atlas, Build &build) {
+    static const std::size_t MAX_SIZE = 1024 * 64;
+    static const std::size_t HEADER_SIZE = 20, PAGE_SIZE = 4, RECT_SIZE = 14;
+    Data data;
+    if (!data.read_optional(atlas + ".dat", MAX_SIZE)) {
+        Log::info("%s: no baked sprite sheet", atlas.c_str());
+        return false;
+    }
+
+    const Sprite *sprites = build.sprites;
+    std::size_t count = build.count;
+    unsigned hash = 2166136261u;
+    for (std::size_t i = 0; i < count; i++) {
+        for (const char *p = sprites[i].name; ; p++) {
+            hash = (hash ^ static_cast<unsigned char>(*p)) * 16777619u;
+            if (!*p)
+                break;
+        }
+    }
+
+    const unsigned char *ptr = static_cast<const unsigned char *>(data.ptr());
+    std::size_t size = data.size();
+    if (size < HEADER_SIZE || std::memcmp(ptr, "DLSA", 4) ||
+        read_u32(ptr + 4) != 1) {
+        Log::warn("%s: invalid baked sprite sheet", atlas.c_str());
+        return false;
+    }
+    std::size_t npages = read_u32(ptr + 12);
+    if (read_u32(ptr + 8) != count || read_u32(ptr + 16) != hash ||
+        size != HEADER_SIZE + npages * PAGE_SIZE + count * RECT_SIZE) {
+        Log::warn("%s: baked sprite sheet is out of date", atlas.c_str());
+        return false;
+    }
+
+    std::vector<SpriteRect> &rects = build.rects;
+    rects.clear();
+    rects.reserve(count);
+    const unsigned char *rp = ptr + HEADER_SIZE + npages * PAGE_SIZE;
+    for (std::size_t i = 0; i < count; i++, rp += RECT_SIZE) {
+        SpriteRect rect;
+        rect.x = read_i16(rp);
+        rect.y = read_i16(rp + 2);
+        rect.w = read_i16(rp + 4);
+        rect.h = read_i16(rp + 6);
+        rect.cx = read_i16(rp + 8);
+        rect.cy = read_i16(rp + 10);
+        rect.page = rp[12];
+        rect.rotated = rp[13] != 0;
+        if (rect.w != sprites[i].w || rect.h != sprites[i].h ||
+            static_cast<std::size_t>(rect.page) >= npages) {
+            Log::warn("%s: baked sprite sheet is out of date",
+                      atlas.c_str());
+            return false;
+        }
+        // Sprites which are part of a larger image are offset.
+        if (rect.rotated) {
+            rect.x += sprites[i].y;
+            rect.y += sprites[i].x;
+        } else {
+            rect.x += sprites[i].x;
+            rect.y += sprites[i].y;
+        }
+        rect.cx = sprites[i].cx;
+        rect.cy = sprites[i].cy;
+        rects.push_back(rect);
+    }
+
+    build.pagesizes.clear();
+    for (std::size_t i = 0; i < npages; i++) {
+        const unsigned char *pp = ptr + HEADER_SIZE + i * PAGE_SIZE;
+        Packing::Size sz = {
+            static_cast<int>(read_u16(pp)),
+            static_cast<int>(read_u16(pp + 2))
+        };
+        build.pagesizes.push_back(sz);
+    }
+    return true;
+}
 
 }
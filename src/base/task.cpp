@@ -0,0 +1,110 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "task.hpp"
+#include "thread.hpp"
+#include <deque>
+#include <vector>
+namespace Base {
+
+struct TaskPool::Data {
+    Mutex m_lock;
+    // Signaled when a task is queued or the pool is stopping.
+    CondVar m_work;
+    // Signaled when the last running task finishes.
+    CondVar m_idle;
+    std::deque<std::function<void()>> m_queue;
+    std::vector<std::unique_ptr<Thread>> m_thread;
+    int m_active;
+    bool m_stop;
+
+    Data() : m_active(0), m_stop(false) { }
+
+    static void entry(void *arg);
+    void run_one(std::function<void()> &func);
+};
+
+void TaskPool::Data::entry(void *arg) {
+    auto &d = *static_cast<Data *>(arg);
+    Lock lock(d.m_lock);
+    while (true) {
+        if (d.m_queue.empty()) {
+            if (d.m_stop)
+                return;
+            d.m_work.wait(d.m_lock);
+            continue;
+        }
+        auto func = std::move(d.m_queue.front());
+        d.m_queue.pop_front();
+        d.run_one(func);
+    }
+}
+
+// Run a task which has been removed from the queue.  The lock must be
+// held, and it is released while the task runs.
+void TaskPool::Data::run_one(std::function<void()> &func) {
+    m_active++;
+    m_lock.unlock();
+    func();
+    m_lock.lock();
+    m_active--;
+    if (m_active == 0 && m_queue.empty())
+        m_idle.broadcast();
+}
+
+TaskPool::TaskPool(int threads)
+    : m_data(new Data) {
+    for (int i = 0; i < threads; i++) {
+        std::unique_ptr<Thread> thread(new Thread);
+        thread->start(Data::entry, m_data.get());
+        m_data->m_thread.push_back(std::move(thread));
+    }
+}
+
+TaskPool::~TaskPool() {
+    wait();
+    {
+        Lock lock(m_data->m_lock);
+        m_data->m_stop = true;
+        m_data->m_work.broadcast();
+    }
+    for (auto &thread : m_data->m_thread)
+        thread->join();
+}
+
+int TaskPool::threads() const {
+    return static_cast<int>(m_data->m_thread.size());
+}
+
+void TaskPool::add(std::function<void()> func) {
+    auto &d = *m_data;
+    if (d.m_thread.empty()) {
+        func();
+        return;
+    }
+    Lock lock(d.m_lock);
+    d.m_queue.push_back(std::move(func));
+    d.m_work.signal();
+}
+
+void TaskPool::wait() {
+    auto &d = *m_data;
+    Lock lock(d.m_lock);
+    while (true) {
+        if (!d.m_queue.empty()) {
+            auto func = std::move(d.m_queue.front());
+            d.m_queue.pop_front();
+            d.run_one(func);
+        } else if (d.m_active > 0) {
+            d.m_idle.wait(d.m_lock);
+        } else {
+            return;
+        }
+    }
+}
+
+int TaskPool::default_threads() {
+    return Thread::processor_count() - 1;
+}
+
+}
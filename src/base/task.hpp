@@ -0,0 +1,37 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_BASE_TASK_HPP
+#define LD_BASE_TASK_HPP
+#include <functional>
+#include <memory>
+namespace Base {
+
+/// A pool of worker threads which run independent tasks.
+class TaskPool {
+    struct Data;
+    std::unique_ptr<Data> m_data;
+
+public:
+    /// Create a pool with the given number of worker threads.
+    explicit TaskPool(int threads);
+    TaskPool(const TaskPool &) = delete;
+    /// Wait for all tasks to finish, then stop the worker threads.
+    ~TaskPool();
+    TaskPool &operator=(const TaskPool &) = delete;
+
+    /// Get the number of worker threads.
+    int threads() const;
+    /// Queue a task to run on a worker thread.
+    void add(std::function<void()> func);
+    /// Wait until every queued task has finished.  The calling
+    /// thread runs queued tasks while it waits.
+    void wait();
+
+    /// Get the number of worker threads to use on this machine.  This
+    /// leaves one processor for the main thread.
+    static int default_threads();
+};
+
+}
+#endif
@@ -0,0 +1,254 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "thread.hpp"
+#include "sg/entry.h"
+#include "sg/thread.h"
+
+#if defined SG_THREAD_PTHREAD
+# include <pthread.h>
+# include <sys/time.h>
+# include <errno.h>
+# include <unistd.h>
+#elif defined SG_THREAD_WINDOWS
+# include <windows.h>
+#else
+# error "Unknown threading system"
+#endif
+
+namespace Base {
+
+#if defined SG_THREAD_PTHREAD
+
+struct Mutex::Data {
+    pthread_mutex_t mutex;
+};
+
+Mutex::Mutex()
+    : m_data(new Data) {
+    int r = pthread_mutex_init(&m_data->mutex, nullptr);
+    if (r) sg_sys_abort("pthread_mutex_init");
+}
+
+Mutex::~Mutex() {
+    pthread_mutex_destroy(&m_data->mutex);
+}
+
+void Mutex::lock() {
+    int r = pthread_mutex_lock(&m_data->mutex);
+    if (r) sg_sys_abort("pthread_mutex_lock");
+}
+
+void Mutex::unlock() {
+    int r = pthread_mutex_unlock(&m_data->mutex);
+    if (r) sg_sys_abort("pthread_mutex_unlock");
+}
+
+struct CondVar::Data {
+    pthread_cond_t cond;
+};
+
+CondVar::CondVar()
+    : m_data(new Data) {
+    int r = pthread_cond_init(&m_data->cond, nullptr);
+    if (r) sg_sys_abort("pthread_cond_init");
+}
+
+CondVar::~CondVar() {
+    pthread_cond_destroy(&m_data->cond);
+}
+
+void CondVar::wait(Mutex &mutex) {
+    int r = pthread_cond_wait(&m_data->cond, &mutex.m_data->mutex);
+    if (r) sg_sys_abort("pthread_cond_wait");
+}
+
+bool CondVar::wait(Mutex &mutex, unsigned msec) {
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    long long nsec = (long long) tv.tv_usec * 1000 +
+        (long long) (msec % 1000) * 1000000;
+    timespec ts;
+    ts.tv_sec = tv.tv_sec + msec / 1000 + (time_t) (nsec / 1000000000);
+    ts.tv_nsec = (long) (nsec % 1000000000);
+    int r = pthread_cond_timedwait(
+        &m_data->cond, &mutex.m_data->mutex, &ts);
+    if (r == ETIMEDOUT)
+        return false;
+    if (r) sg_sys_abort("pthread_cond_timedwait");
+    return true;
+}
+
+void CondVar::signal() {
+    int r = pthread_cond_signal(&m_data->cond);
+    if (r) sg_sys_abort("pthread_cond_signal");
+}
+
+void CondVar::broadcast() {
+    int r = pthread_cond_broadcast(&m_data->cond);
+    if (r) sg_sys_abort("pthread_cond_broadcast");
+}
+
+struct Thread::Data {
+    pthread_t thread;
+    bool running;
+    void (*func)(void *);
+    void *arg;
+
+    static void *entry(void *arg) {
+        auto data = static_cast<Data *>(arg);
+        data->func(data->arg);
+        return nullptr;
+    }
+};
+
+Thread::Thread()
+    : m_data(new Data) {
+    m_data->running = false;
+}
+
+Thread::~Thread() {
+    if (m_data->running)
+        sg_sys_abort("thread was not joined");
+}
+
+void Thread::start(void (*func)(void *), void *arg) {
+    if (m_data->running)
+        sg_sys_abort("thread already running");
+    m_data->func = func;
+    m_data->arg = arg;
+    int r = pthread_create(&m_data->thread, nullptr, Data::entry,
+                           m_data.get());
+    if (r) sg_sys_abort("pthread_create");
+    m_data->running = true;
+}
+
+void Thread::join() {
+    if (!m_data->running)
+        return;
+    int r = pthread_join(m_data->thread, nullptr);
+    if (r) sg_sys_abort("pthread_join");
+    m_data->running = false;
+}
+
+#elif defined SG_THREAD_WINDOWS
+
+struct Mutex::Data {
+    CRITICAL_SECTION mutex;
+};
+
+Mutex::Mutex()
+    : m_data(new Data) {
+    InitializeCriticalSection(&m_data->mutex);
+}
+
+Mutex::~Mutex() {
+    DeleteCriticalSection(&m_data->mutex);
+}
+
+void Mutex::lock() {
+    EnterCriticalSection(&m_data->mutex);
+}
+
+void Mutex::unlock() {
+    LeaveCriticalSection(&m_data->mutex);
+}
+
+struct CondVar::Data {
+    CONDITION_VARIABLE cond;
+};
+
+CondVar::CondVar()
+    : m_data(new Data) {
+    InitializeConditionVariable(&m_data->cond);
+}
+
+CondVar::~CondVar()
+{ }
+
+void CondVar::wait(Mutex &mutex) {
+    BOOL r = SleepConditionVariableCS(
+        &m_data->cond, &mutex.m_data->mutex, INFINITE);
+    if (!r) sg_sys_abort("SleepConditionVariableCS");
+}
+
+bool CondVar::wait(Mutex &mutex, unsigned msec) {
+    BOOL r = SleepConditionVariableCS(
+        &m_data->cond, &mutex.m_data->mutex, msec);
+    if (r)
+        return true;
+    if (GetLastError() == ERROR_TIMEOUT)
+        return false;
+    sg_sys_abort("SleepConditionVariableCS");
+}
+
+void CondVar::signal() {
+    WakeConditionVariable(&m_data->cond);
+}
+
+void CondVar::broadcast() {
+    WakeAllConditionVariable(&m_data->cond);
+}
+
+struct Thread::Data {
+    HANDLE thread;
+    void (*func)(void *);
+    void *arg;
+
+    static DWORD WINAPI entry(void *arg) {
+        auto data = static_cast<Data *>(arg);
+        data->func(data->arg);
+        return 0;
+    }
+};
+
+Thread::Thread()
+    : m_data(new Data) {
+    m_data->thread = nullptr;
+}
+
+Thread::~Thread() {
+    if (m_data->thread)
+        sg_sys_abort("thread was not joined");
+}
+
+void Thread::start(void (*func)(void *), void *arg) {
+    if (m_data->thread)
+        sg_sys_abort("thread already running");
+    m_data->func = func;
+    m_data->arg = arg;
+    m_data->thread = CreateThread(
+        nullptr, 0, Data::entry, m_data.get(), 0, nullptr);
+    if (!m_data->thread) sg_sys_abort("CreateThread");
+}
+
+void Thread::join() {
+    if (!m_data->thread)
+        return;
+    WaitForSingleObject(m_data->thread, INFINITE);
+    CloseHandle(m_data->thread);
+    m_data->thread = nullptr;
+}
+
+#endif
+
+bool Thread::running() const {
+#if defined SG_THREAD_PTHREAD
+    return m_data->running;
+#else
+    return m_data->thread != nullptr;
+#endif
+}
+
+int Thread::processor_count() {
+#if defined SG_THREAD_PTHREAD
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long n = info.dwNumberOfProcessors;
+#endif
+    return n > 1 ? static_cast<int>(n) : 1;
+}
+
+}
@@ -0,0 +1,81 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_BASE_THREAD_HPP
+#define LD_BASE_THREAD_HPP
+#include <memory>
+namespace Base {
+
+/// A mutual exclusion lock.
+class Mutex {
+    friend class CondVar;
+    struct Data;
+    std::unique_ptr<Data> m_data;
+
+public:
+    Mutex();
+    Mutex(const Mutex &) = delete;
+    ~Mutex();
+    Mutex &operator=(const Mutex &) = delete;
+
+    void lock();
+    void unlock();
+};
+
+/// Hold a mutex for the duration of a scope.
+class Lock {
+    Mutex &m_mutex;
+
+public:
+    explicit Lock(Mutex &mutex) : m_mutex(mutex) { m_mutex.lock(); }
+    Lock(const Lock &) = delete;
+    ~Lock() { m_mutex.unlock(); }
+    Lock &operator=(const Lock &) = delete;
+};
+
+/// A condition variable.
+class CondVar {
+    struct Data;
+    std::unique_ptr<Data> m_data;
+
+public:
+    CondVar();
+    CondVar(const CondVar &) = delete;
+    ~CondVar();
+    CondVar &operator=(const CondVar &) = delete;
+
+    /// Wait for the condition to be signaled.  The mutex must be held.
+    void wait(Mutex &mutex);
+    /// Wait for the condition to be signaled, or for the given number
+    /// of milliseconds to pass.  Returns false on timeout.
+    bool wait(Mutex &mutex, unsigned msec);
+    /// Wake one waiting thread.
+    void signal();
+    /// Wake all waiting threads.
+    void broadcast();
+};
+
+/// A joinable thread.
+class Thread {
+    struct Data;
+    std::unique_ptr<Data> m_data;
+
+public:
+    Thread();
+    Thread(const Thread &) = delete;
+    ~Thread();
+    Thread &operator=(const Thread &) = delete;
+
+    /// Start running the function in a new thread.
+    void start(void (*func)(void *), void *arg);
+    /// Wait for the thread to finish.
+    void join();
+    /// Determine whether the thread has been started and not joined.
+    bool running() const;
+
+    /// Get the number of processors online, at least one.
+    static int processor_count();
+};
+
+}
+#endif
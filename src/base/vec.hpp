@@ -84,6 +84,8 @@ inline IVec &operator-=(IVec &u, IVec v) { u.x -= v.x; u.y -= v.y; return u; }
 inline IVec operator*(int a, IVec v) { return IVec(a * v.x, a * v.y); }
 inline IVec operator*(IVec v, int a) { return IVec(a * v.x, a * v.y); }
 inline IVec &operator*=(IVec &v, int a) { v.x *= a; v.y *= a; return v; }
+inline bool operator==(IVec u, IVec v) { return u.x == v.x && u.y == v.y; }
+inline bool operator!=(IVec u, IVec v) { return u.x != v.x || u.y != v.y; }
 
 /// Integer rectangle.
 struct IRect {
@@ -0,0 +1,110 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "watch.hpp"
+#include "cvar.hpp"
+#include "log.hpp"
+#include <algorithm>
+
+#if defined __linux__
+# include <sys/inotify.h>
+# include <unistd.h>
+# include <errno.h>
+# define HAVE_INOTIFY 1
+#endif
+
+namespace Base {
+
+#if defined HAVE_INOTIFY
+
+FileWatcher::FileWatcher()
+    : m_fd(-1) {
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0)
+        Log::warn("inotify_init1 failed, file watching disabled");
+}
+
+FileWatcher::~FileWatcher() {
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+void FileWatcher::add(const std::string &dirname) {
+    if (m_fd < 0)
+        return;
+    // The data path may contain several directories.
+    std::string paths = CVar::get_string("path", "data", "data");
+    std::size_t pos = 0;
+    while (pos <= paths.size()) {
+        std::size_t end = paths.find(':', pos);
+        if (end == std::string::npos)
+            end = paths.size();
+        std::string dirpath = paths.substr(pos, end - pos);
+        pos = end + 1;
+        if (dirpath.empty())
+            continue;
+        dirpath += '/';
+        dirpath += dirname;
+        int wd = inotify_add_watch(
+            m_fd, dirpath.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0)
+            continue;
+        Log::debug("watching %s", dirpath.c_str());
+        m_watch.push_back(std::pair<int, std::string>(wd, dirname));
+    }
+}
+
+void FileWatcher::poll(std::vector<std::string> &changed) {
+    if (m_fd < 0)
+        return;
+    alignas(inotify_event) char buf[4096];
+    while (true) {
+        ssize_t amt = read(m_fd, buf, sizeof(buf));
+        if (amt <= 0) {
+            if (amt < 0 && errno != EAGAIN && errno != EINTR)
+                Log::warn("inotify read failed");
+            break;
+        }
+        const char *ptr = buf, *end = buf + amt;
+        while (ptr < end) {
+            const inotify_event *evt =
+                reinterpret_cast<const inotify_event *>(ptr);
+            ptr += sizeof(inotify_event) + evt->len;
+            if (evt->len == 0 || (evt->mask & IN_ISDIR) != 0 ||
+                evt->name[0] == '.')
+                continue;
+            for (auto &w : m_watch) {
+                if (w.first != evt->wd)
+                    continue;
+                std::string path(w.second);
+                path += '/';
+                path += evt->name;
+                if (std::find(changed.begin(), changed.end(), path) ==
+                    changed.end())
+                    changed.push_back(std::move(path));
+                break;
+            }
+        }
+    }
+}
+
+#else
+
+FileWatcher::FileWatcher()
+    : m_fd(-1)
+{ }
+
+FileWatcher::~FileWatcher()
+{ }
+
+void FileWatcher::add(const std::string &dirname) {
+    (void) dirname;
+}
+
+void FileWatcher::poll(std::vector<std::string> &changed) {
+    (void) changed;
+}
+
+#endif
+
+}
@@ -0,0 +1,32 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_BASE_WATCH_HPP
+#define LD_BASE_WATCH_HPP
+#include <string>
+#include <utility>
+#include <vector>
+namespace Base {
+
+/// Watch directories in the data path for modified files.  This is
+/// a development aid, and does nothing on platforms without inotify.
+class FileWatcher {
+private:
+    int m_fd;
+    std::vector<std::pair<int, std::string>> m_watch;
+
+public:
+    FileWatcher();
+    FileWatcher(const FileWatcher &) = delete;
+    ~FileWatcher();
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    /// Watch a directory in the data path, such as "level".
+    void add(const std::string &dirname);
+    /// Get the files which changed since the last poll, relative to
+    /// the data path, such as "level/1.txt".  Never blocks.
+    void poll(std::vector<std::string> &changed);
+};
+
+}
+#endif
@@ -3,8 +3,12 @@
    of the 2-clause BSD license.  For more information, see LICENSE.txt. */
 #include "audio.hpp"
 #include "sg/mixer.h"
+#include "base/clock.hpp"
 #include "base/log.hpp"
 #include "base/random.hpp"
+#include "base/task.hpp"
+#include "base/thread.hpp"
+#include <atomic>
 #include <cstring>
 namespace Game {
 
@@ -16,14 +20,54 @@ struct AudioInfo {
 
 #include "audio_array.hpp"
 
-sg_mixer_sound *audio_files[AUDIO_FILE_COUNT];
+// Sounds are decoded in the background, and are null until loaded.
+std::atomic<sg_mixer_sound *> audio_files[AUDIO_FILE_COUNT];
+std::atomic<sg_mixer_sound *> audio_music;
+std::atomic<int> audio_pending;
+long long audio_start;
+Base::TaskPool *audio_pool;
+// Held for every call which uses the mixer's playback state.  Sound
+// files are decoded without it, so playback never waits on a load.
+Base::Mutex audio_lock;
+
+void audio_loaded() {
+    if (--audio_pending == 0)
+        Base::Log::info("audio: loaded %d files in %.1f ms",
+                        AUDIO_FILE_COUNT + 1,
+                        (Base::Clock::micros() - audio_start) * 1e-3);
+}
+
+void load_sfx(int index) {
+    char path[AUDIO_FILE_NAMELEN + 5];
+    std::strcpy(path, "sfx/");
+    std::strcat(path, AUDIO_FILE_NAMES[index]);
+    sg_mixer_sound *sound =
+        sg_mixer_sound_file(path, std::strlen(path), nullptr);
+    if (!sound)
+        Base::Log::warn("%s: failed to load", path);
+    audio_files[index] = sound;
+    audio_loaded();
+}
+
+void load_music() {
+    sg_mixer_sound *sound =
+        sg_mixer_sound_file("music", std::strlen("music"), nullptr);
+    if (!sound)
+        Base::Log::warn("music failed to load");
+    audio_music = sound;
+    audio_loaded();
+}
 }
 
 void Audio::play(unsigned time, Sfx sfx, float volume, float pan) {
     const AudioInfo &info = SFX_INFO[static_cast<int>(sfx)];
     int which = info.offset + Base::Random::gnexti(info.count);
+    sg_mixer_sound *sound = audio_files[which];
+    if (!sound)
+        return;
+    Base::Lock lock(audio_lock);
     auto chan = sg_mixer_channel_play(
-        audio_files[which], time, SG_MIXER_FLAG_DETACHED);
+        sound, time, SG_MIXER_FLAG_DETACHED);
     sg_mixer_param param[2] = {
         { SG_MIXER_PARAM_VOL, volume },
         { SG_MIXER_PARAM_PAN, pan }
@@ -32,28 +76,31 @@ void Audio::play(unsigned time, Sfx sfx, float volume, float pan) {
 }
 
 void Audio::init() {
-    sg_mixer_start();
-    for (int i = 0; i < AUDIO_FILE_COUNT; i++) {
-        char path[AUDIO_FILE_NAMELEN + 5];
-        std::strcpy(path, "sfx/");
-        std::strcat(path, AUDIO_FILE_NAMES[i]);
-        audio_files[i] = sg_mixer_sound_file(
-            path, std::strlen(path), nullptr);
-        if (!audio_files[i])
-            Base::Log::warn("%s: failed to load", path);
+    {
+        Base::Lock lock(audio_lock);
+        sg_mixer_start();
     }
+    audio_start = Base::Clock::micros();
+    audio_pending = AUDIO_FILE_COUNT + 1;
+    // Always use at least one worker, so startup never waits for audio.
+    int threads = Base::TaskPool::default_threads();
+    audio_pool = new Base::TaskPool(threads > 0 ? threads : 1);
+    audio_pool->add(load_music);
+    for (int i = 0; i < AUDIO_FILE_COUNT; i++)
+        audio_pool->add([i]() { load_sfx(i); });
+}
+
+void Audio::finish() {
+    delete audio_pool;
+    audio_pool = nullptr;
 }
 
 void Audio::music(unsigned time, float volume) {
-    static sg_mixer_sound *music;
-    if (!music) {
-        music = sg_mixer_sound_file(
-            "music", std::strlen("music"), nullptr);
-        if (!music)
-            Base::Log::warn("music failed to load");
+    sg_mixer_sound *music = audio_music;
+    if (!music)
         return;
-    }
 
+    Base::Lock lock(audio_lock);
     static sg_mixer_channel *channel;
     if (!channel) {
         channel = sg_mixer_channel_play(music, time, SG_MIXER_FLAG_LOOP);
@@ -64,4 +111,14 @@ void Audio::music(unsigned time, float volume) {
     sg_mixer_channel_setparam(channel, SG_MIXER_PARAM_VOL, volume);
 }
 
+void Audio::settime(unsigned time) {
+    Base::Lock lock(audio_lock);
+    sg_mixer_settime(time);
+}
+
+void Audio::commit() {
+    Base::Lock lock(audio_lock);
+    sg_mixer_commit();
+}
+
 }
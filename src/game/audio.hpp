@@ -6,15 +6,30 @@
 #include "audio_enum.hpp"
 namespace Game {
 
+/// Sound effects and music.  All mixer calls go through these
+/// functions.  Calls which use the playback state are serialized by
+/// one lock, since they come from more than one thread.  Sound files
+/// are decoded by the loading workers outside the lock, so a slow
+/// decode never delays playback.
 struct Audio {
     /// Play a sound effect.
     static void play(unsigned time, Sfx sfx, float volume, float pan);
 
-    /// Load all sound effects.
+    /// Start loading all sound effects and music in the background.
+    /// Sounds which have not finished loading are not played.
     static void init();
 
+    /// Wait for background loading to finish.
+    static void finish();
+
     /// Start music, or adjust volume.
     static void music(unsigned time, float volume);
+
+    /// Set the time for sounds played until the next commit.
+    static void settime(unsigned time);
+
+    /// Send the sounds played since the last commit to the mixer.
+    static void commit();
 };
 
 }
@@ -2,12 +2,31 @@
    This file is part of Dreamless.  Dreamless is licensed under the terms
    of the 2-clause BSD license.  For more information, see LICENSE.txt. */
 #include "camera.hpp"
+#include <cmath>
 namespace Game {
 
+namespace {
+
+// Fractional bits in fixed-point camera positions.
+const int FIXED_BITS = 8;
+const float FIXED_SCALE = static_cast<float>(1 << FIXED_BITS);
+
+// Spring smoothing time, and exponential time constant, in seconds.
+const float SPRING_TIME = 0.25f;
+const float EXPONENTIAL_TIME = 0.15f;
+
+long long to_fixed(float x) {
+    return std::llround(x * FIXED_SCALE);
+}
+
+}
+
 Camera::Camera()
     : m_bounds(IRect::zero()), m_camera(IRect::zero()),
-      m_clamp(FRect::zero()), m_target(FVec::zero()),
-      m_pos0(FVec::zero()), m_pos1(FVec::zero())
+      m_clamp(FRect::zero()), m_filter(CameraFilter::VSHAPE),
+      m_initted(false), m_target(FVec::zero()),
+      m_pos0(FVec::zero()), m_pos1(FVec::zero()),
+      m_head(0), m_vel(FVec::zero())
 { }
 
 void Camera::set_bounds(IRect bounds) {
@@ -23,29 +42,32 @@ void Camera::set_fov(IVec camera_size) {
     calculate_clamp();
 }
 
+void Camera::set_filter(CameraFilter filter) {
+    if (filter == m_filter)
+        return;
+    m_filter = filter;
+    if (m_initted)
+        reset(m_pos1);
+}
+
 void Camera::update() {
-    static const int MAX_HISTORY = 32;
-    if (m_history.size() != MAX_HISTORY) {
-        m_history.resize(MAX_HISTORY, m_target);
-        m_pos0 = m_pos1 = m_target;
+    if (!m_initted) {
+        reset(m_target);
+        m_initted = true;
         return;
     }
-    m_history.pop_back();
-    m_history.insert(m_history.begin(), m_target);
-
-    // Triangular filter
-    double accx = 0.0, accy = 0.0, accw = 0.0;
-    for (int i = 0; i < MAX_HISTORY; i++) {
-        int w1 = i + 1;
-        int w2 = MAX_HISTORY - i;
-        double weight = w1 > w2 ? w1 : w2;
-        accx += weight * m_history[i].x;
-        accy += weight * m_history[i].y;
-        accw += weight;
-    }
     m_pos0 = m_pos1;
-    m_pos1.x = (float) (accx / accw);
-    m_pos1.y = (float) (accy / accw);
+    switch (m_filter) {
+    case CameraFilter::VSHAPE:
+        m_pos1 = update_vshape();
+        break;
+    case CameraFilter::SPRING:
+        m_pos1 = update_spring();
+        break;
+    case CameraFilter::EXPONENTIAL:
+        m_pos1 = update_exponential();
+        break;
+    }
 }
 
 void Camera::set_target(FVec target, bool override) {
@@ -78,4 +100,83 @@ void Camera::calculate_clamp() {
     }
 }
 
+void Camera::reset(FVec pos) {
+    m_pos0 = m_pos1 = pos;
+    m_vel = FVec::zero();
+    Fixed p = { to_fixed(pos.x), to_fixed(pos.y) };
+    for (int i = 0; i < HISTORY; i++)
+        m_history[i] = p;
+    m_head = 0;
+    // Ages 0..HALF-1 in the newer half, HALF..HISTORY-1 in the older.
+    long long age0 = HALF * (HALF - 1) / 2;
+    long long age1 = HISTORY * (HISTORY - 1) / 2 - age0;
+    m_sum[0].x = m_sum[1].x = HALF * p.x;
+    m_sum[0].y = m_sum[1].y = HALF * p.y;
+    m_agesum[0].x = age0 * p.x;
+    m_agesum[0].y = age0 * p.y;
+    m_agesum[1].x = age1 * p.x;
+    m_agesum[1].y = age1 * p.y;
+}
+
+FVec Camera::update_vshape() {
+    // Sum of all weights: max(age + 1, HISTORY - age) over all ages.
+    static const long long WEIGHT = HALF * (HISTORY + HALF + 1);
+
+    // The oldest entry leaves the older half, and the entry at age
+    // HALF - 1 moves from the newer half to the older half.
+    Fixed oldest = m_history[(m_head + 1) % HISTORY];
+    Fixed middle = m_history[(m_head + HISTORY - (HALF - 1)) % HISTORY];
+    m_sum[1].x -= oldest.x;
+    m_sum[1].y -= oldest.y;
+    m_agesum[1].x -= (HISTORY - 1) * oldest.x;
+    m_agesum[1].y -= (HISTORY - 1) * oldest.y;
+    m_sum[0].x -= middle.x;
+    m_sum[0].y -= middle.y;
+    m_agesum[0].x -= (HALF - 1) * middle.x;
+    m_agesum[0].y -= (HALF - 1) * middle.y;
+
+    // Everything else gets one tick older.
+    for (int i = 0; i < 2; i++) {
+        m_agesum[i].x += m_sum[i].x;
+        m_agesum[i].y += m_sum[i].y;
+    }
+
+    m_sum[1].x += middle.x;
+    m_sum[1].y += middle.y;
+    m_agesum[1].x += HALF * middle.x;
+    m_agesum[1].y += HALF * middle.y;
+
+    // The new target enters at age 0, replacing the oldest entry.
+    Fixed p = { to_fixed(m_target.x), to_fixed(m_target.y) };
+    m_head = (m_head + 1) % HISTORY;
+    m_history[m_head] = p;
+    m_sum[0].x += p.x;
+    m_sum[0].y += p.y;
+
+    long long accx = HISTORY * m_sum[0].x - m_agesum[0].x +
+        m_agesum[1].x + m_sum[1].x;
+    long long accy = HISTORY * m_sum[0].y - m_agesum[0].y +
+        m_agesum[1].y + m_sum[1].y;
+    double scale = 1.0 / (static_cast<double>(WEIGHT) * FIXED_SCALE);
+    return FVec(static_cast<float>(accx * scale),
+                static_cast<float>(accy * scale));
+}
+
+FVec Camera::update_spring() {
+    // Closed-form approximation of a critically damped spring, which
+    // is stable for any time step.
+    float omega = 2.0f / SPRING_TIME;
+    float x = omega * Defs::dt();
+    float decay = 1.0f / (1.0f + x + 0.48f * x * x + 0.235f * x * x * x);
+    FVec change = m_pos1 - m_target;
+    FVec temp = (m_vel + omega * change) * Defs::dt();
+    m_vel = (m_vel - omega * temp) * decay;
+    return m_target + (change + temp) * decay;
+}
+
+FVec Camera::update_exponential() {
+    float alpha = 1.0f - std::exp(-Defs::dt() / EXPONENTIAL_TIME);
+    return m_pos1 + (m_target - m_pos1) * alpha;
+}
+
 }
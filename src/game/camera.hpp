@@ -4,16 +4,47 @@
 #ifndef LD_GAME_CAMERA_HPP
 #define LD_GAME_CAMERA_HPP
 #include "defs.hpp"
-#include <vector>
 namespace Game {
 
+/// Camera smoothing filters.
+enum class CameraFilter {
+    /// Weighted average of recent targets, favoring the newest and
+    /// oldest targets.
+    VSHAPE,
+    /// Critically damped spring.
+    SPRING,
+    /// Exponential moving average.
+    EXPONENTIAL
+};
+
 class Camera {
+    static const int HISTORY = 32;
+    static const int HALF = HISTORY / 2;
+
+    /// Fixed-point position, used for exact running sums.
+    struct Fixed {
+        long long x, y;
+    };
+
     IRect m_bounds;
     IRect m_camera;
     FRect m_clamp;
-    std::vector<FVec> m_history;
+    CameraFilter m_filter;
+    bool m_initted;
     FVec m_target, m_pos0, m_pos1;
 
+    // V-shaped filter state.  The history is a ring buffer of recent
+    // targets, with m_head pointing at the newest.  The newer half is
+    // weighted (HISTORY - age), the older half (age + 1), which are
+    // maintained as sums of positions and sums of age * position.
+    Fixed m_history[HISTORY];
+    int m_head;
+    Fixed m_sum[2];
+    Fixed m_agesum[2];
+
+    // Spring filter state.
+    FVec m_vel;
+
 public:
     Camera();
 
@@ -24,6 +55,9 @@ public:
     /// Set the camera field of view.  Must be called at least once.
     void set_fov(IVec camera_size);
 
+    /// Set the smoothing filter.
+    void set_filter(CameraFilter filter);
+
     /// Update the camera position.
     void update();
 
@@ -38,6 +72,10 @@ public:
 
 private:
     void calculate_clamp();
+    void reset(FVec pos);
+    FVec update_vshape();
+    FVec update_spring();
+    FVec update_exponential();
 };
 
 }
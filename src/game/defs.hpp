@@ -8,7 +8,7 @@
 #include "base/sprite.hpp"
 #include "graphics/layer.hpp"
 #include "graphics/sprite.hpp"
-#include "graphics/system.hpp"
+#include "graphics/frame.hpp"
 #include <cmath>
 namespace Game {
 typedef Base::Log Log;
@@ -23,6 +23,9 @@ typedef ::Graphics::AnySprite AnySprite;
 typedef ::Graphics::Sprite Sprite;
 typedef ::Graphics::Tile Tile;
 typedef ::Graphics::Layer Layer;
+using ::Graphics::DEPTH_BACK;
+using ::Graphics::DEPTH_NORMAL;
+using ::Graphics::DEPTH_FRONT;
 
 struct Defs {
     /// Screen width.
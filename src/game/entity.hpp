@@ -52,7 +52,7 @@ public:
     /// Update the entity's state for the next frame.
     virtual void update();
     /// Draw the entity.
-    virtual void draw(::Graphics::System &gr, int delta) const = 0;
+    virtual void draw(::Graphics::Frame &gr, int delta) const = 0;
     /// Get the entity's team.
     Team team() const { return m_team; }
     /// Get the entitiy's position.
@@ -7,6 +7,8 @@
 #include "minion.hpp"
 #include "player.hpp"
 #include "main.hpp"
+#include "base/cvar.hpp"
+#include "base/profile.hpp"
 #include "base/random.hpp"
 #include "graphics/color.hpp"
 #include <algorithm>
@@ -15,17 +17,24 @@ namespace Game {
 static const int DREAM_TIME = 50;
 static const int WIN_DELAY = 50;
 static const float NOISE_SPEED = 0.01f;
+static const int MINIMAP_WIDTH = 160;
+static const int MINIMAP_HEIGHT = 90;
+static const int MINIMAP_SCALE = 4;
 
 static bool entity_is_alive(const std::unique_ptr<Entity> &p) {
     return p->team() != Team::DEAD;
 }
 
 GameScreen::GameScreen(const ControlState &ctl, int levelnum, unsigned time)
-    : Screen(ctl), m_levelnum(levelnum), m_drawn(false), m_time(time),
+    : Screen(ctl), m_levelnum(levelnum),
+      m_tile_key(Graphics::Frame::new_tile_key()), m_time(time),
       m_dream(-1), m_minions(0), m_wincounter(-1), m_id(0) {
+    m_minimap = Base::CVar::get_bool("game", "minimap", false);
+    m_particle_test = Base::CVar::get_int("debug", "particles", 0);
     m_level.load(std::to_string(levelnum));
     m_camera.set_bounds(m_level.bounds());
     m_camera.set_fov(IVec(Defs::WIDTH, Defs::HEIGHT));
+    m_camera.set_filter(m_level.camera_filter());
     typedef Level::SpawnType Spawn;
     typedef Item::Type IType;
     for (auto &sp : m_level.spawn_points()) {
@@ -100,14 +109,9 @@ static const char HELP[] =
     "[F7]: previous level\n"
     "[F8]: next level\n";
 
-void GameScreen::draw(::Graphics::System &gr, int delta) {
-    if (!m_drawn) {
-        gr.clear(true);
-        m_level.draw(gr);
-        m_drawn = true;
-    } else {
-        gr.clear(false);
-    }
+void GameScreen::draw(::Graphics::Frame &gr, int delta) {
+    Base::ProfileScope scope("GameScreen::draw");
+    gr.clear();
 
     using Graphics::Color;
     if (!control().get_button(Button::HELP)) {
@@ -146,10 +150,43 @@ void GameScreen::draw(::Graphics::System &gr, int delta) {
 
     for (auto &ent : m_entity)
         ent->draw(gr, delta);
-    gr.set_camera(m_camera.drawpos(delta));
+    m_particles.draw(gr, delta);
+    IVec camera = m_camera.drawpos(delta);
+    gr.set_camera(camera);
+
+    // The tiles must cover everything visible, including the minimap.
+    // The visible area depends on the window size, and is only unknown
+    // if nothing is being drawn to a window.
+    IRect visible = gr.visible();
+    if (visible.x0 >= visible.x1 || visible.y0 >= visible.y1)
+        visible = IRect(0, 0, Defs::WIDTH, Defs::HEIGHT);
+    visible = visible.offset(camera);
+    if (m_minimap) {
+        IVec center = camera + IVec(Defs::WIDTH / 2, Defs::HEIGHT / 2);
+        IVec mpos = center - IVec(MINIMAP_WIDTH * MINIMAP_SCALE / 2,
+                                  MINIMAP_HEIGHT * MINIMAP_SCALE / 2);
+        gr.add_view(
+            IRect(Defs::WIDTH - 4 - MINIMAP_WIDTH, 4,
+                  Defs::WIDTH - 4, 4 + MINIMAP_HEIGHT),
+            mpos,
+            MINIMAP_SCALE,
+            world);
+        visible = IRect(
+            std::min(visible.x0, mpos.x), std::min(visible.y0, mpos.y),
+            std::max(visible.x1, mpos.x + MINIMAP_WIDTH * MINIMAP_SCALE),
+            std::max(visible.y1, mpos.y + MINIMAP_HEIGHT * MINIMAP_SCALE));
+    }
+
+    if (m_chunks.set_window(m_level, visible))
+        m_tile_key = Graphics::Frame::new_tile_key();
+    if (gr.tile_key() != m_tile_key) {
+        gr.clear_tiles(m_tile_key);
+        m_chunks.draw(gr);
+    }
 }
 
 void GameScreen::update(unsigned time) {
+    Base::ProfileScope scope("GameScreen::update");
     m_analytics.time_end = time - m_analytics.time_start;
 
     if (m_wincounter > 0) {
@@ -192,12 +229,35 @@ void GameScreen::update(unsigned time) {
     m_new_entity.clear();
     for (auto &ent : m_entity)
         ent->update();
+    m_particles.update();
+    if (m_particle_test > 0) {
+        int count = static_cast<int>(m_particles.count(Particle::WAKE));
+        if (count < m_particle_test)
+            m_particles.emit(Particle::WAKE, m_camera.center(),
+                             m_particle_test - count);
+    }
     auto part = std::stable_partition(
         m_entity.begin(), m_entity.end(), entity_is_alive);
     m_entity.erase(part, m_entity.end());
     m_camera.update();
 }
 
+void GameScreen::reload_level(int level) {
+    if (level != m_levelnum)
+        return;
+    Level newlevel;
+    if (!newlevel.try_load(std::to_string(level))) {
+        Log::warn("could not reload level %d, keeping the old level",
+                  level);
+        return;
+    }
+    m_level = std::move(newlevel);
+    m_camera.set_bounds(m_level.bounds());
+    m_camera.set_filter(m_level.camera_filter());
+    m_chunks.reset();
+    m_tile_key = Graphics::Frame::new_tile_key();
+}
+
 void GameScreen::add_entity(Entity *ent) {
     if (ent)
         m_new_entity.push_back(std::unique_ptr<Entity>(ent));
@@ -223,6 +283,10 @@ void GameScreen::play_sound(Sfx sfx, float volume) {
     Audio::play(m_time + Defs::FRAMETIME, sfx, volume, 0.0f);
 }
 
+void GameScreen::emit_particles(Particle type, FVec pos, int count) {
+    m_particles.emit(type, pos, count);
+}
+
 bool GameScreen::is_dreaming() const {
     return m_dream > DREAM_TIME / 2 || m_dream < 0;
 }
@@ -233,6 +297,7 @@ void GameScreen::wake_up() {
     m_analytics.time_wake = m_time - m_analytics.time_start;
     m_dream = DREAM_TIME;
     play_sound(Sfx::WHA, -10.0f);
+    emit_particles(Particle::WAKE, m_camera.center(), 600);
 }
 
 void GameScreen::capture_minion() {
@@ -4,9 +4,11 @@
 #ifndef LD_GAME_GAME_SCREEN_HPP
 #define LD_GAME_GAME_SCREEN_HPP
 #include "level.hpp"
+#include "level_chunks.hpp"
 #include "screen.hpp"
 #include "camera.hpp"
 #include "audio.hpp"
+#include "particles.hpp"
 #include "analytics/analytics.hpp"
 #include <memory>
 #include <string>
@@ -17,16 +19,21 @@ class Entity;
 class GameScreen : public Screen {
     /// The level number.
     int m_levelnum;
-    /// Whether static data has been uploaded.
-    bool m_drawn;
+    /// Key for the tiles drawn from the current level data.
+    unsigned m_tile_key;
     /// The current level data.
     Level m_level;
+    LevelChunks m_chunks;
     /// The level camera.
     Camera m_camera;
     /// List of active entities.
     std::vector<std::unique_ptr<Entity>> m_entity;
     /// List of new entities, not yet active.
     std::vector<std::unique_ptr<Entity>> m_new_entity;
+    /// Particle effects.
+    ParticleSystem m_particles;
+    /// Number of particles to keep alive for stress testing.
+    int m_particle_test;
     /// Current timestamp.
     unsigned m_time;
     /// If -1, we are dreaming.  0 is awake.  Positive is countdown to
@@ -40,6 +47,8 @@ class GameScreen : public Screen {
     int m_wincounter;
     /// Unique ID number generator.
     int m_id;
+    /// Whether to show a zoomed-out view of the level.
+    bool m_minimap;
     /// Analytics info.
     Analytics::Level m_analytics;
 
@@ -48,9 +57,11 @@ public:
     virtual ~GameScreen();
 
     /// Draw the screen.
-    virtual void draw(::Graphics::System &gr, int delta);
+    virtual void draw(::Graphics::Frame &gr, int delta);
     /// Update the screen for the next frame.
     virtual void update(unsigned time);
+    /// Reload the level tiles, keeping the current entities.
+    virtual void reload_level(int level);
 
     /// Add an entity to the level, takes ownership.  NULL is ok.
     void add_entity(Entity *ent);
@@ -72,6 +83,9 @@ public:
     /// Play a sound with no associated location.
     void play_sound(Sfx sfx, float volume);
 
+    /// Emit a burst of particles at the given location.
+    void emit_particles(Particle type, FVec pos, int count);
+
     /// Whether we are currently in dream.
     bool is_dreaming() const;
 
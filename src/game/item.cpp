@@ -13,19 +13,22 @@ Item::Item(GameScreen &scr, IVec pos, Type type)
 Item::~Item()
 { }
 
-void Item::draw(::Graphics::System &gr, int delta) const {
+void Item::draw(::Graphics::Frame &gr, int delta) const {
     (void) delta;
     switch (m_type) {
     case Type::DOOR_OPEN:
-        gr.add_sprite(Sprite::DOOR_OPEN, m_pos, Layer::PHYSICAL);
+        gr.add_sprite(Sprite::DOOR_OPEN, m_pos, Layer::PHYSICAL,
+                      Orientation::NORMAL, DEPTH_BACK);
         break;
 
     case Type::DOOR_CLOSED:
-        gr.add_sprite(Sprite::DOOR_CLOSED, m_pos, Layer::PHYSICAL);
+        gr.add_sprite(Sprite::DOOR_CLOSED, m_pos, Layer::PHYSICAL,
+                      Orientation::NORMAL, DEPTH_BACK);
         break;
 
     case Type::DOOR_LOCKED:
-        gr.add_sprite(Sprite::DOOR_LOCKED, m_pos, Layer::PHYSICAL);
+        gr.add_sprite(Sprite::DOOR_LOCKED, m_pos, Layer::PHYSICAL,
+                      Orientation::NORMAL, DEPTH_BACK);
         break;
 
     case Type::KEY:
@@ -27,7 +27,7 @@ public:
     Item(GameScreen &scr, IVec pos, Type type);
     virtual ~Item();
 
-    virtual void draw(::Graphics::System &gr, int delta) const;
+    virtual void draw(::Graphics::Frame &gr, int delta) const;
     Type type() const { return m_type; }
     Action action() const { return m_action; }
     void set_type(Type type) { m_type = type; }
@@ -6,7 +6,7 @@
 #include "base/file.hpp"
 #include "graphics/layer.hpp"
 #include "graphics/sprite.hpp"
-#include "graphics/system.hpp"
+#include <algorithm>
 #include <cstring>
 #include <cstdio>
 #include <vector>
@@ -70,7 +70,8 @@ float Level::tile_floor(IVec pos, float relx) const {
 }
 
 Level::Level()
-    : m_width(0), m_height(0), m_data(nullptr) {
+    : m_width(0), m_height(0), m_data(nullptr),
+      m_camera_filter(CameraFilter::VSHAPE) {
     if (!is_initialized) {
         const TileInfo *p = TILES_RAW;
         for (; p->c != '\0'; p++)
@@ -82,10 +83,15 @@ Level::Level()
 Level::Level(Level &&other)
     : m_width(other.m_width),
       m_height(other.m_height),
-      m_data(other.m_data) {
+      m_data(other.m_data),
+      m_spawn(std::move(other.m_spawn)),
+      m_dialogue(std::move(other.m_dialogue)),
+      m_camera_filter(other.m_camera_filter) {
     other.m_width = 0;
     other.m_height = 0;
     other.m_data = nullptr;
+    for (int i = 0; i < ACTION_COUNT; i++)
+        m_action[i] = other.m_action[i];
 }
 
 Level::~Level() {
@@ -104,6 +110,11 @@ Level &Level::operator=(Level &&other) {
     m_width = width;
     m_height = height;
     m_data = data;
+    m_spawn = std::move(other.m_spawn);
+    m_dialogue = std::move(other.m_dialogue);
+    for (int i = 0; i < ACTION_COUNT; i++)
+        m_action[i] = other.m_action[i];
+    m_camera_filter = other.m_camera_filter;
     return *this;
 }
 
@@ -140,13 +151,18 @@ std::vector<Line>::const_iterator find_break(
         if (lp->second > 1 && lp->first[0] == '-')
             return lp;
     }
-    Log::abort("Could not find level delimiter");
+    Log::error("could not find level delimiter");
     return le;
 }
 
 }
 
 void Level::load(const std::string &name) {
+    if (!try_load(name))
+        Log::abort("could not load level %s", name.c_str());
+}
+
+bool Level::try_load(const std::string &name) {
     Log::info("loading level %s", name.c_str());
 
     static size_t MAX_SIZE = 1024 * 32;
@@ -154,7 +170,10 @@ void Level::load(const std::string &name) {
     path += name;
     path += ".txt";
     Base::Data filedata;
-    filedata.read(path, MAX_SIZE);
+    if (!filedata.read_optional(path, MAX_SIZE)) {
+        Log::error("could not read %s", path.c_str());
+        return false;
+    }
 
     auto lines = read_lines(filedata);
 
@@ -163,17 +182,24 @@ void Level::load(const std::string &name) {
     m_width = 0;
     m_height = 0;
     m_data = nullptr;
+    m_spawn.clear();
+    m_dialogue.clear();
 
     {
         for (int i = 0; i < ACTION_COUNT; i++)
             m_action[i] = false;
+        m_camera_filter = CameraFilter::VSHAPE;
         auto first_break = find_break(lines);
+        if (first_break == lines.end())
+            return false;
         std::string white(" ");
         for (auto lp = lines.begin(); lp != first_break; lp++) {
             std::string line(lp->first, lp->second);
             auto i = line.find(':');
-            if (i == std::string::npos)
-                Log::abort("invalid line: '%s'", line.c_str());
+            if (i == std::string::npos) {
+                Log::error("invalid line: '%s'", line.c_str());
+                return false;
+            }
             auto name = line.substr(0, i);
             auto j = line.find_first_not_of(white, i + 1);
             std::string data;
@@ -188,11 +214,22 @@ void Level::load(const std::string &name) {
                     case 't': case 'T': action = Action::TURN; break;
                     case 'd': case 'D': action = Action::DROP; break;
                     default:
-                        Log::abort("unknown action: '%c'", c);
-                        return;
+                        Log::error("unknown action: '%c'", c);
+                        return false;
                     }
                     m_action[static_cast<int>(action)] = true;
                 }
+            } else if (name == "camera") {
+                if (data == "vshape")
+                    m_camera_filter = CameraFilter::VSHAPE;
+                else if (data == "spring")
+                    m_camera_filter = CameraFilter::SPRING;
+                else if (data == "exponential")
+                    m_camera_filter = CameraFilter::EXPONENTIAL;
+                else {
+                    Log::error("unknown camera filter: %s", data.c_str());
+                    return false;
+                }
             } else if (name == "girl") {
                 Dialogue d = { std::move(data), 0 };
                 m_dialogue.push_back(std::move(d));
@@ -200,15 +237,21 @@ void Level::load(const std::string &name) {
                 Dialogue d = { std::move(data), 1 };
                 m_dialogue.push_back(std::move(d));
             } else {
-                Log::abort("unknown property: %s", name.c_str());
+                Log::error("unknown property: %s", name.c_str());
+                return false;
             }
         }
         lines.erase(lines.begin(), first_break + 1);
-        lines.erase(find_break(lines), lines.end());
+        auto second_break = find_break(lines);
+        if (second_break == lines.end())
+            return false;
+        lines.erase(second_break, lines.end());
     }
 
-    if (lines.size() > std::numeric_limits<int>::max())
-        Log::abort("level too large");
+    if (lines.size() > std::numeric_limits<int>::max()) {
+        Log::error("level too large");
+        return false;
+    }
     int height = static_cast<int>(lines.size());
     int width = 0;
     for (auto &line : lines) {
@@ -273,21 +316,28 @@ void Level::load(const std::string &name) {
             sp.pos.y * Defs::TILESZ + dy);
     }
 
-    if (errors)
-        Log::abort("level contains errors");
+    if (errors) {
+        Log::error("level contains errors");
+        return false;
+    }
+    return true;
 }
 
-void Level::draw(::Graphics::System &gr) const {
-    (void) &gr;
-    int width = m_width, height = m_height;
+void Level::get_tiles(std::vector<TileSprite> &out, IRect rect) const {
+    int width = m_width;
+    int x0 = std::max(rect.x0, 0), x1 = std::min(rect.x1, m_width);
+    int y0 = std::max(rect.y0, 0), y1 = std::min(rect.y1, m_height);
     const unsigned char *data = m_data;
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            auto &info = tile_info(data[y * width + x]);
-            auto tile = info.tile;
-            IVec pos(32 * x + 16, 32 * y + 16);
-            if (tile != Tile::NONE)
-                gr.add_sprite(tile, pos, Layer::TILE);
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            auto tile = tile_info(data[y * width + x]).tile;
+            if (tile == Tile::NONE)
+                continue;
+            TileSprite sp;
+            sp.tile = tile;
+            sp.pos = IVec(Defs::TILESZ * x + Defs::TILESZ / 2,
+                          Defs::TILESZ * y + Defs::TILESZ / 2);
+            out.push_back(sp);
         }
     }
 }
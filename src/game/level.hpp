@@ -5,11 +5,9 @@
 #define LD_GAME_LEVEL_HPP
 #include "defs.hpp"
 #include "action.hpp"
+#include "camera.hpp"
 #include <string>
 #include <vector>
-namespace Graphics {
-class System;
-}
 namespace Game {
 
 struct Dialogue {
@@ -36,6 +34,12 @@ public:
         IVec pos;
     };
 
+    /// A tile sprite, positioned at the center of the tile.
+    struct TileSprite {
+        Tile tile;
+        IVec pos;
+    };
+
 private:
     struct SpawnInfo {
         unsigned char c;
@@ -70,6 +74,7 @@ private:
     std::vector<SpawnPoint> m_spawn;
     std::vector<Dialogue> m_dialogue;
     bool m_action[ACTION_COUNT];
+    CameraFilter m_camera_filter;
 
 public:
     Level();
@@ -79,8 +84,14 @@ public:
     Level &operator=(const Level &) = delete;
     Level &operator=(Level &&other);
 
+    /// Load a level, aborting if it is invalid.
     void load(const std::string &name);
-    void draw(::Graphics::System &gr) const;
+    /// Load a level, returning false and logging the errors if it is
+    /// invalid.  The level must be discarded if loading fails.
+    bool try_load(const std::string &name);
+    /// Get the sprites for the tiles in a rectangle, in tile
+    /// coordinates.  The rectangle may extend outside the level.
+    void get_tiles(std::vector<TileSprite> &out, IRect rect) const;
 
     /// Test whether a point hits the level.
     bool hit_test(FVec pos) const;
@@ -102,6 +113,9 @@ public:
         return m_action[static_cast<int>(action)];
     }
 
+    /// Get the camera smoothing filter for this level.
+    CameraFilter camera_filter() const { return m_camera_filter; }
+
 private:
     static const TileInfo &tile_info(unsigned char tile) {
         return TILES[tile];
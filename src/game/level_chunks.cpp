@@ -0,0 +1,101 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "level_chunks.hpp"
+#include "graphics/frame.hpp"
+#include "graphics/layer.hpp"
+#include <algorithm>
+namespace Game {
+
+namespace {
+
+const int CHUNK_PIXELS = LevelChunks::CHUNK_SIZE * Defs::TILESZ;
+
+// Round down to a chunk coordinate.
+int chunk_floor(int x) {
+    return x >= 0 ?
+        x / CHUNK_PIXELS : -((CHUNK_PIXELS - 1 - x) / CHUNK_PIXELS);
+}
+
+}
+
+LevelChunks::LevelChunks()
+    : m_clock(0), m_window(IRect::zero())
+{ }
+
+void LevelChunks::reset() {
+    m_chunk.clear();
+    m_visible.clear();
+    m_window = IRect::zero();
+}
+
+bool LevelChunks::set_window(const Level &level, IRect rect) {
+    IRect need(
+        chunk_floor(rect.x0), chunk_floor(rect.y0),
+        chunk_floor(rect.x1 - 1) + 1, chunk_floor(rect.y1 - 1) + 1);
+    // Keep the window while it still covers the rectangle, so the
+    // tile layer is not rebuilt every time the camera moves.
+    if (need.x0 >= m_window.x0 && need.x1 <= m_window.x1 &&
+        need.y0 >= m_window.y0 && need.y1 <= m_window.y1)
+        return false;
+
+    // Extend the window by one chunk in each direction.  Only chunks
+    // inside the level are built.
+    m_window = need.expand(1);
+    IRect bounds = level.bounds();
+    int x0 = std::max(m_window.x0, 0);
+    int y0 = std::max(m_window.y0, 0);
+    int x1 = std::min(m_window.x1, chunk_floor(bounds.x1 - 1) + 1);
+    int y1 = std::min(m_window.y1, chunk_floor(bounds.y1 - 1) + 1);
+
+    m_clock++;
+    m_visible.clear();
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++)
+            m_visible.push_back(get_chunk(level, IVec(x, y)));
+    }
+    return true;
+}
+
+void LevelChunks::draw(::Graphics::Frame &gr) const {
+    for (std::size_t i : m_visible) {
+        for (auto &sp : m_chunk[i].tiles)
+            gr.add_sprite(sp.tile, sp.pos, ::Graphics::Layer::TILE);
+    }
+}
+
+std::size_t LevelChunks::get_chunk(const Level &level, IVec pos) {
+    std::size_t n = m_chunk.size(), index = n;
+    for (std::size_t i = 0; i < n; i++) {
+        if (m_chunk[i].pos == pos) {
+            m_chunk[i].last_used = m_clock;
+            return i;
+        }
+    }
+
+    // Evict the least recently used chunk which is not visible.
+    if (n >= MAX_CHUNKS) {
+        unsigned oldest = m_clock;
+        for (std::size_t i = 0; i < n; i++) {
+            if (m_chunk[i].last_used != m_clock &&
+                m_clock - m_chunk[i].last_used > m_clock - oldest) {
+                oldest = m_chunk[i].last_used;
+                index = i;
+            }
+        }
+    }
+    if (index == n)
+        m_chunk.emplace_back();
+
+    Chunk &chunk = m_chunk[index];
+    chunk.pos = pos;
+    chunk.last_used = m_clock;
+    chunk.tiles.clear();
+    level.get_tiles(
+        chunk.tiles,
+        IRect(pos.x * CHUNK_SIZE, pos.y * CHUNK_SIZE,
+              (pos.x + 1) * CHUNK_SIZE, (pos.y + 1) * CHUNK_SIZE));
+    return index;
+}
+
+}
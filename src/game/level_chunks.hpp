@@ -0,0 +1,57 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_GAME_LEVEL_CHUNKS_HPP
+#define LD_GAME_LEVEL_CHUNKS_HPP
+#include "defs.hpp"
+#include "level.hpp"
+#include <vector>
+namespace Graphics {
+class Frame;
+}
+namespace Game {
+
+/// The tile sprites of a level, built in square chunks around the
+/// camera.  Only the chunks in the current window are drawn.  Built
+/// chunks are cached, and the least recently used chunks are evicted
+/// when the cache is full, so the cost of drawing tiles does not
+/// depend on the size of the level.
+class LevelChunks {
+public:
+    /// Width and height of a chunk, in tiles.
+    static const int CHUNK_SIZE = 16;
+    /// Number of chunks to cache.  Visible chunks are never evicted,
+    /// so a larger window can exceed this.
+    static const std::size_t MAX_CHUNKS = 64;
+
+private:
+    struct Chunk {
+        IVec pos;
+        unsigned last_used;
+        std::vector<Level::TileSprite> tiles;
+    };
+
+    std::vector<Chunk> m_chunk;
+    unsigned m_clock;
+    // Window of visible chunks, in chunk coordinates.
+    IRect m_window;
+    // Indexes of the visible chunks.
+    std::vector<std::size_t> m_visible;
+
+public:
+    LevelChunks();
+
+    /// Discard all chunks, after the level changes.
+    void reset();
+    /// Make the chunks covering a rectangle, in pixels, visible.
+    /// Returns true if the visible chunks changed.
+    bool set_window(const Level &level, IRect rect);
+    /// Draw the tiles in the visible chunks.
+    void draw(::Graphics::Frame &gr) const;
+
+private:
+    std::size_t get_chunk(const Level &level, IVec pos);
+};
+
+}
+#endif
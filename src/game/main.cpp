@@ -5,10 +5,15 @@
 
 #include "sg/entry.h"
 #include "sg/event.h"
-#include "sg/mixer.h"
 #include "sg/record.h"
 #include "sg/keycode.h"
+#include "base/clock.hpp"
+#include "base/cvar.hpp"
+#include "base/log.hpp"
+#include "base/pixel.hpp"
 #include "base/sprite.hpp"
+#include "base/watch.hpp"
+#include "graphics/color.hpp"
 #include "graphics/system.hpp"
 #include "graphics/sprite.hpp"
 #include "control.hpp"
@@ -17,16 +22,61 @@
 #include "screen.hpp"
 #include "audio.hpp"
 #include "analytics/analytics.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
 
 namespace {
 const float MUSIC_VOLUME = -12.0;
+// Number of ticks and frames after loading a level which are allowed
+// to allocate memory.
+const int ALLOC_WARMUP_TICKS = 64;
+const int ALLOC_WARMUP_FRAMES = 120;
+// Duration of the wipe between levels, in milliseconds.
+const float TRANSITION_TIME = 500.0f;
+// Time when the game started, or -1 after the first frame is drawn.
+long long startup_time = -1;
 }
 
 namespace Game {
 
-Main::Main() : m_initted(false), m_pending(1) { }
+Main::Main()
+    : m_pending(1),
+      m_tick_allocs("tick", ALLOC_WARMUP_TICKS),
+      m_frame_allocs("frame", ALLOC_WARMUP_FRAMES),
+      m_stop(false), m_clock_msec(0), m_clock_us(0),
+      m_visible(IRect::zero()),
+      m_level_serial(0), m_render_level_serial(0),
+      m_published_serial(0), m_published_level(0), m_render_serial(0),
+      m_load_level(0), m_load_time(0), m_load_done(false),
+      m_transition_capture(false), m_transition_ready(false),
+      m_transition_active(false), m_transition_msec(0),
+      m_overlay_visible(false) {
+    for (int i = 0; i < 2; i++) {
+        m_published_time[i] = 0;
+        m_render_time[i] = 0;
+    }
+    m_threaded = Base::CVar::get_bool("game", "threaded", false);
+    if (Base::CVar::get_bool("debug", "pixelbench", false))
+        Base::PixelConv::benchmark();
+    if (Base::CVar::get_bool("debug", "hotreload", false)) {
+        m_watcher.reset(new Base::FileWatcher);
+        m_watcher->add("level");
+        m_watcher->add("shader");
+    }
+}
 
 Main::~Main() {
+    if (m_thread.running()) {
+        {
+            Base::Lock lock(m_lock);
+            m_stop = true;
+            m_cond.broadcast();
+        }
+        m_thread.join();
+    }
+    if (m_loader.running())
+        m_loader.join();
     // The destructor is not really safe, it calls OpenGL functions.
     // So we intentionally leak the object.
     m_graphics.release();
@@ -35,8 +85,12 @@ Main::~Main() {
 void Main::event(sg_event &evt) {
     switch (evt.type) {
     case SG_EVENT_VIDEO_INIT:
-        if (!m_graphics)
+        if (!m_graphics) {
+            long long start = Base::Clock::micros();
             m_graphics.reset(new Graphics::System);
+            Log::info("graphics: initialized in %.1f ms",
+                      (Base::Clock::micros() - start) * 1e-3);
+        }
         break;
 
     case SG_EVENT_KDOWN:
@@ -53,20 +107,94 @@ void Main::event(sg_event &evt) {
 }
 
 void Main::draw(int width, int height, unsigned msec) {
-    advance(msec);
+    m_frame_allocs.begin();
+    reload_assets();
 
     Graphics::System &gr = *m_graphics;
-    int delta = msec - m_frametime;
     gr.set_size(width, height);
-    m_screen->draw(gr, delta);
+    IRect visible = Graphics::System::visible_rect(width, height);
+    long long start;
+    if (m_threaded) {
+        {
+            Base::Lock lock(m_lock);
+            m_visible = visible;
+            m_clock_msec = msec;
+            m_clock_us = Base::Clock::micros();
+            if (m_render_serial != m_published_serial) {
+                m_render[0].copy_from(m_published[0]);
+                m_render[1].copy_from(m_published[1]);
+                m_render_time[0] = m_published_time[0];
+                m_render_time[1] = m_published_time[1];
+                m_render_serial = m_published_serial;
+            }
+        }
+        if (!m_thread.running())
+            m_thread.start(simulate_entry, this);
+        start = Base::Clock::micros();
+        // Frames are displayed one tick after their timestamps, and
+        // are interpolated across the real gap between them.
+        int gap = (int) (m_render_time[1] - m_render_time[0]);
+        if (gap <= 0)
+            gap = Defs::FRAMETIME;
+        float frac =
+            (float) (int) (msec - Defs::FRAMETIME - m_render_time[0]) /
+            (float) gap;
+        if (frac < 0.0f)
+            frac = 0.0f;
+        else if (frac > 1.0f)
+            frac = 1.0f;
+        gr.set_frame(m_render[0], m_render[1], frac);
+    } else {
+        advance(msec);
+        start = Base::Clock::micros();
+        int delta;
+        {
+            Base::Lock lock(m_lock);
+            delta = m_pacer.delta(msec);
+        }
+        // While a level loads, the last frame of the old screen is
+        // shown again instead of being redrawn.
+        if (!m_loader.running()) {
+            m_frame.set_visible(visible);
+            m_screen->draw(m_frame, delta);
+        }
+        gr.set_frame(m_frame);
+    }
+    if (m_overlay_visible) {
+        draw_overlay();
+        gr.add_overlay(m_overlay);
+    }
+    bool captured = transition(gr, msec);
     gr.finalize();
     gr.draw();
+    Base::Profile::end_frame();
+    if (startup_time >= 0) {
+        Log::info("startup: first frame after %.1f ms",
+                  (Base::Clock::micros() - startup_time) * 1e-3);
+        startup_time = -1;
+    }
+
+    Base::Lock lock(m_lock);
+    m_pacer.end_draw(Base::Clock::micros() - start);
+    // The old screen stays frozen until its picture is captured.
+    if (captured)
+        m_transition_capture = false;
+    if (m_render_level_serial != m_level_serial) {
+        m_render_level_serial = m_level_serial;
+        m_frame_allocs.reset();
+    }
+    m_frame_allocs.end();
 }
 
 void Main::load_level(int level) {
     m_pending = level;
 }
 
+FrameStats Main::frame_stats() const {
+    Base::Lock lock(m_lock);
+    return m_pacer.stats();
+}
+
 void Main::event_key(int key, bool state) {
     Button button;
     switch (key) {
@@ -117,6 +245,27 @@ void Main::event_key(int key, bool state) {
         button = Button::HELP;
         break;
 
+    case KEY_F3:
+        if (state) {
+            m_overlay_visible = !m_overlay_visible;
+            Base::Profile::set_enabled(m_overlay_visible);
+        }
+        return;
+
+    case KEY_F4:
+        if (state) {
+            if (Base::Profile::tracing()) {
+                std::string path = Base::Profile::stop_trace();
+                Base::Profile::set_enabled(m_overlay_visible);
+                if (!path.empty())
+                    Log::info("wrote trace: %s", path.c_str());
+            } else {
+                Base::Profile::start_trace();
+                Log::info("recording trace");
+            }
+        }
+        return;
+
     case KEY_F7:
     case KEY_PageUp:
         button = Button::PREVLEVEL;
@@ -128,8 +277,10 @@ void Main::event_key(int key, bool state) {
         break;
 
     case KEY_F10:
-        if (state)
-            sg_record_start(m_frametime + Defs::FRAMETIME);
+        if (state) {
+            Base::Lock lock(m_lock);
+            sg_record_start(m_pacer.frametime() + Defs::FRAMETIME);
+        }
         return;
 
     case KEY_F11:
@@ -145,42 +296,256 @@ void Main::event_key(int key, bool state) {
     default:
         return;
     }
-    m_control.set_button(button, state);
-}
-
-void Main::advance(unsigned time) {
-    unsigned nframes;
-    if (m_initted) {
-        Audio::music(time, MUSIC_VOLUME);
-        unsigned delta = time - m_frametime;
-        if (delta > Defs::MAXUPDATE) {
-            Log::warn("lag");
-            nframes = 1;
-            m_frametime = time;
-        } else {
-            nframes = delta / Defs::FRAMETIME;
-            m_frametime += nframes * Defs::FRAMETIME;
+    Input input = { button, state };
+    Base::Lock lock(m_lock);
+    m_input.push_back(input);
+}
+
+unsigned Main::advance(unsigned time) {
+    Base::ProfileScope scope("Main::advance");
+    unsigned nframes, frametime;
+    bool loading = m_loader.running(), loaded = false;
+    {
+        Base::Lock lock(m_lock);
+        nframes = m_pacer.begin_frame(time);
+        frametime = m_pacer.frametime();
+        if (loading && m_load_done && !m_transition_capture) {
+            loading = false;
+            loaded = true;
         }
-    } else {
-        m_initted = true;
-        m_frametime = time;
-        nframes = 1;
     }
+    if (loaded)
+        load_finish();
+    if (loading) {
+        // Input waits in the queue for the new screen, since the
+        // loader may be reading the control state.  No ticks run, so
+        // none are counted, and neither draw path redraws the old
+        // screen.
+        Base::Lock lock(m_lock);
+        m_pacer.end_update(0, 0);
+        return 0;
+    }
+    {
+        Base::Lock lock(m_lock);
+        for (auto &input : m_input)
+            m_control.set_button(input.button, input.state);
+        m_input.clear();
+        if (m_screen) {
+            for (int level : m_reload) {
+                Log::info("reloading level %d", level);
+                m_screen->reload_level(level);
+                m_level_serial++;
+                m_tick_allocs.reset();
+            }
+        }
+        m_reload.clear();
+    }
+    Audio::music(time, MUSIC_VOLUME);
 
     if (m_pending) {
-        m_screen.reset(new GameScreen(m_control, m_pending, time));
+        int level = m_pending;
         m_pending = 0;
+        if (m_screen) {
+            load_start(level, time);
+            Base::Lock lock(m_lock);
+            m_pacer.end_update(0, 0);
+            return 0;
+        }
+        m_screen.reset(new GameScreen(m_control, level, time));
         nframes = 1;
+        m_tick_allocs.reset();
+        Base::Lock lock(m_lock);
+        m_level_serial++;
     }
 
+    long long start = Base::Clock::micros();
     for (unsigned i = 0; i < nframes; i++) {
         unsigned utime =
-            m_frametime + (i - nframes + 1) * Defs::FRAMETIME;
-        sg_mixer_settime(utime);
+            frametime + (i - nframes + 1) * Defs::FRAMETIME;
+        Audio::settime(utime);
+        m_tick_allocs.begin();
         m_screen->update(utime);
-        sg_mixer_commit();
+        m_tick_allocs.end();
+        Audio::commit();
         m_control.update();
     }
+    long long elapsed = Base::Clock::micros() - start;
+
+    Base::Lock lock(m_lock);
+    m_pacer.end_update(nframes, elapsed);
+    return nframes;
+}
+
+void Main::load_start(int level, unsigned time) {
+    Log::info("loading level %d", level);
+    m_load_level = level;
+    m_load_time = time;
+    {
+        Base::Lock lock(m_lock);
+        m_load_done = false;
+        m_transition_capture = true;
+    }
+    m_loader.start(load_entry, this);
+}
+
+void Main::load_finish() {
+    m_loader.join();
+    m_screen = std::move(m_loaded);
+    m_tick_allocs.reset();
+    Base::Lock lock(m_lock);
+    m_load_done = false;
+    m_transition_ready = true;
+    m_level_serial++;
+}
+
+void Main::load_entry(void *arg) {
+    Main &m = *static_cast<Main *>(arg);
+    long long start = Base::Clock::micros();
+    m.m_loaded.reset(new GameScreen(m.m_control, m.m_load_level,
+                                    m.m_load_time));
+    Log::info("level %d: loaded in %.1f ms", m.m_load_level,
+              (Base::Clock::micros() - start) * 1e-3);
+    Base::Lock lock(m.m_lock);
+    m.m_load_done = true;
+}
+
+bool Main::transition(Graphics::System &gr, unsigned msec) {
+    bool capture, ready;
+    {
+        Base::Lock lock(m_lock);
+        capture = m_transition_capture;
+        ready = m_transition_ready;
+        m_transition_ready = false;
+    }
+    if (capture) {
+        gr.capture_transition();
+        m_transition_active = false;
+    }
+    if (ready) {
+        m_transition_active = true;
+        m_transition_msec = msec;
+    }
+    if (m_transition_active) {
+        float t = (float) (int) (msec - m_transition_msec) *
+            (1.0f / TRANSITION_TIME);
+        if (t < 0.0f)
+            t = 0.0f;
+        gr.set_transition(t);
+        if (t >= 1.0f)
+            m_transition_active = false;
+    }
+    return capture;
+}
+
+void Main::simulate() {
+    Base::Lock lock(m_lock);
+    while (!m_stop) {
+        IRect visible = m_visible;
+        unsigned now = m_clock_msec +
+            (unsigned) ((Base::Clock::micros() - m_clock_us) / 1000);
+        m_lock.unlock();
+        unsigned nframes = advance(now);
+        if (nframes) {
+            // The frame shows the state at the end of the last tick,
+            // which is displayed one tick after the tick's timestamp.
+            m_frame.set_visible(visible);
+            m_screen->draw(m_frame, Defs::FRAMETIME);
+        }
+        m_lock.lock();
+        if (nframes) {
+            std::swap(m_published[0], m_published[1]);
+            std::swap(m_published[1], m_frame);
+            // After a catch-up, the two frames are more than one tick
+            // apart.  The first frame of a level is treated as if it
+            // followed one tick after the previous frame.
+            unsigned time = m_pacer.frametime();
+            m_published_time[0] =
+                m_published_serial && m_published_level == m_level_serial ?
+                m_published_time[1] : time - Defs::FRAMETIME;
+            m_published_time[1] = time;
+            m_published_level = m_level_serial;
+            m_published_serial++;
+        }
+        if (m_stop)
+            break;
+        unsigned elapsed = m_clock_msec - m_pacer.frametime() +
+            (unsigned) ((Base::Clock::micros() - m_clock_us) / 1000);
+        if (elapsed < (unsigned) Defs::FRAMETIME)
+            m_cond.wait(m_lock, Defs::FRAMETIME - elapsed);
+    }
+}
+
+void Main::simulate_entry(void *arg) {
+    static_cast<Main *>(arg)->simulate();
+}
+
+void Main::reload_assets() {
+    if (!m_watcher)
+        return;
+    m_changed.clear();
+    m_watcher->poll(m_changed);
+    for (auto &path : m_changed) {
+        std::size_t slash = path.find('/');
+        std::size_t dot = path.find('.', slash);
+        if (slash == std::string::npos || dot == std::string::npos)
+            continue;
+        std::string dir = path.substr(0, slash);
+        std::string name = path.substr(slash + 1, dot - slash - 1);
+        std::string ext = path.substr(dot);
+        if (dir == "level" && ext == ".txt") {
+            int level = std::atoi(name.c_str());
+            if (level > 0) {
+                Base::Lock lock(m_lock);
+                m_reload.push_back(level);
+            }
+        } else if (dir == "shader" &&
+                   (ext == ".vert.glsl" || ext == ".frag.glsl" ||
+                    ext == ".glsl")) {
+            if (m_graphics)
+                m_graphics->reload_shader(name);
+        }
+    }
+}
+
+void Main::draw_overlay() {
+    FrameStats stats = frame_stats();
+    Base::Profile::get(m_profile);
+    m_overlay_text.clear();
+    char buf[96];
+    std::snprintf(
+        buf, sizeof(buf),
+        "ticks %u/frame  tick %.2f ms  update %.2f  draw %.2f\n",
+        stats.last_ticks, stats.tick_cost * 1e-3,
+        stats.last_update_time * 1e-3, stats.last_draw_time * 1e-3);
+    m_overlay_text += buf;
+    bool allocs = Base::Alloc::available();
+    if (allocs) {
+        std::snprintf(
+            buf, sizeof(buf), "allocs: %llu/frame (%llu B)\n",
+            m_frame_allocs.last().count, m_frame_allocs.last().bytes);
+        m_overlay_text += buf;
+    }
+    for (auto &e : m_profile) {
+        int n = std::snprintf(
+            buf, sizeof(buf), "%-24s %3u %6.2f %6.2f %6.2f",
+            e.name, e.count, e.last, e.average, e.peak);
+        if (allocs && n > 0 && (std::size_t) n < sizeof(buf))
+            std::snprintf(buf + n, sizeof(buf) - n, " %5llu",
+                          e.allocs.count);
+        m_overlay_text += buf;
+        m_overlay_text += '\n';
+    }
+    if (Base::Profile::tracing())
+        m_overlay_text += "[F4]: recording trace\n";
+
+    m_overlay.clear();
+    m_overlay.put_text(
+        IVec(Defs::WIDTH - 4, Defs::HEIGHT - 4),
+        Graphics::HAlign::RIGHT,
+        Graphics::VAlign::TOP,
+        -1,
+        Graphics::Color::palette(18),
+        m_overlay_text);
 }
 
 Main *Main::main;
@@ -188,6 +553,7 @@ Main *Main::main;
 }
 
 void sg_game_init(void) {
+    startup_time = Base::Clock::micros();
     Base::Log::init();
     Game::Audio::init();
     Analytics::Analytics::init();
@@ -196,6 +562,7 @@ void sg_game_init(void) {
 
 void sg_game_destroy(void) {
     delete Game::Main::main;
+    Game::Audio::finish();
     Analytics::Analytics::finish();
 }
 
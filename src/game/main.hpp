@@ -4,8 +4,18 @@
 #ifndef LD_GAME_MAIN_HPP
 #define LD_GAME_MAIN_HPP
 #include "control.hpp"
+#include "pacing.hpp"
+#include "base/alloc.hpp"
+#include "base/profile.hpp"
+#include "base/thread.hpp"
+#include "graphics/frame.hpp"
 #include <memory>
+#include <string>
+#include <vector>
 union sg_event;
+namespace Base {
+class FileWatcher;
+}
 namespace Graphics {
 class System;
 }
@@ -14,12 +24,80 @@ class Screen;
 
 class Main {
 private:
+    struct Input {
+        Button button;
+        bool state;
+    };
+
     ControlState m_control;
     std::unique_ptr<Graphics::System> m_graphics;
     std::unique_ptr<Screen> m_screen;
-    bool m_initted;
-    unsigned m_frametime;
+    FramePacer m_pacer;
     int m_pending;
+    std::unique_ptr<Base::FileWatcher> m_watcher;
+    std::vector<std::string> m_changed;
+
+    // Steady-state allocation checks.  The tick check runs on the
+    // simulation thread, the frame check on the render thread.
+    Base::AllocCheck m_tick_allocs;
+    Base::AllocCheck m_frame_allocs;
+
+    /// The frame which the screen draws into.
+    Graphics::Frame m_frame;
+
+    // When threaded, the simulation runs on its own thread, and
+    // publishes a frame after each tick.  The render thread draws by
+    // interpolating between the last two published frames.
+    bool m_threaded;
+    Base::Thread m_thread;
+    // Protects everything below, and the pacer.
+    mutable Base::Mutex m_lock;
+    Base::CondVar m_cond;
+    bool m_stop;
+    // Maps the high-resolution clock to the timestamps passed to draw.
+    unsigned m_clock_msec;
+    long long m_clock_us;
+    // The area of the world visible in the window, relative to the
+    // camera.
+    Base::IRect m_visible;
+    // Input and level reloads, waiting for the simulation.
+    std::vector<Input> m_input;
+    std::vector<int> m_reload;
+    // Incremented whenever a level is loaded or reloaded.
+    unsigned m_level_serial;
+    unsigned m_render_level_serial;
+    // The last two published frames, the times of the ticks they
+    // show, and the level serial of the last frame.
+    Graphics::Frame m_published[2];
+    unsigned m_published_time[2];
+    unsigned m_published_serial;
+    unsigned m_published_level;
+    // Copies of the published frames, owned by the render thread.
+    Graphics::Frame m_render[2];
+    unsigned m_render_time[2];
+    unsigned m_render_serial;
+
+    // Levels after the first load in the background.  The old screen
+    // is frozen until the new one is ready, and the render thread
+    // keeps its last picture for the transition.  The loader thread
+    // only touches the fields in the first group.
+    Base::Thread m_loader;
+    int m_load_level;
+    unsigned m_load_time;
+    std::unique_ptr<Screen> m_loaded;
+    // Protected by m_lock.
+    bool m_load_done;
+    bool m_transition_capture;
+    bool m_transition_ready;
+    // Owned by the render thread.
+    bool m_transition_active;
+    unsigned m_transition_msec;
+
+    // Profiling overlay, drawn on the render thread.
+    bool m_overlay_visible;
+    Graphics::Frame m_overlay;
+    std::vector<Base::ProfileEntry> m_profile;
+    std::string m_overlay_text;
 
 public:
     static Main *main;
@@ -29,10 +107,20 @@ public:
     void event(sg_event &evt);
     void draw(int width, int height, unsigned msec);
     void load_level(int level);
+    /// Get the frame pacing counters.
+    FrameStats frame_stats() const;
 
 private:
     void event_key(int key, bool state);
-    void advance(unsigned time);
+    unsigned advance(unsigned time);
+    void reload_assets();
+    bool transition(Graphics::System &gr, unsigned msec);
+    void load_start(int level, unsigned time);
+    void load_finish();
+    static void load_entry(void *arg);
+    void draw_overlay();
+    void simulate();
+    static void simulate_entry(void *arg);
 };
 
 }
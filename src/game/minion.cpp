@@ -117,7 +117,7 @@ void Minion::update() {
     m_memory.erase(part, m_memory.end());
 }
 
-void Minion::draw(::Graphics::System &gr, int delta) const {
+void Minion::draw(::Graphics::Frame &gr, int delta) const {
     IVec pos = m_mover.drawpos(delta);
 
     gr.add_sprite(
@@ -130,7 +130,9 @@ void Minion::draw(::Graphics::System &gr, int delta) const {
         gr.add_sprite(
             Sprite::KEY,
             pos + IVec(0, 24),
-            Layer::PHYSICAL);
+            Layer::PHYSICAL,
+            Orientation::NORMAL,
+            DEPTH_FRONT);
     }
 }
 
@@ -144,6 +146,7 @@ void Minion::hit_item(Item &item) {
         m_team = Team::DEAD;
         item.set_type(IType::DOOR_OPEN);
         m_screen.play_sound(Sfx::OPEN, -10.0f, m_mover.pos());
+        m_screen.emit_particles(Particle::SPARKLE, m_mover.pos(), 48);
         m_screen.capture_minion();
         break;
 
@@ -152,6 +155,7 @@ void Minion::hit_item(Item &item) {
             m_team = Team::DEAD;
             m_screen.play_sound(Sfx::UNLOCK,  -10.0f, m_mover.pos());
             item.set_type(IType::DOOR_OPEN);
+            m_screen.emit_particles(Particle::SPARKLE, m_mover.pos(), 48);
             m_screen.capture_minion();
         } else {
             m_screen.play_sound(Sfx::LOCKED, -10.0f, m_mover.pos());
@@ -164,6 +168,7 @@ void Minion::hit_item(Item &item) {
             m_haskey = true;
             item.destroy();
             m_screen.play_sound(Sfx::PLINK, -10.0f, m_mover.pos());
+            m_screen.emit_particles(Particle::PICKUP, m_mover.pos(), 24);
         }
         break;
 
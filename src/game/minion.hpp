@@ -39,7 +39,7 @@ public:
     virtual ~Minion();
 
     virtual void update();
-    virtual void draw(::Graphics::System &gr, int delta) const;
+    virtual void draw(::Graphics::Frame &gr, int delta) const;
 
 private:
     void hit_item(Item &item);
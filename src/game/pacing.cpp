@@ -0,0 +1,99 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "pacing.hpp"
+#include "defs.hpp"
+#include "base/cvar.hpp"
+#include <cstring>
+namespace Game {
+
+namespace {
+// Weight of each new measurement in the smoothed tick cost.
+const float COST_SMOOTHING = 0.05f;
+}
+
+FramePacer::FramePacer()
+    : m_initted(false), m_frametime(0) {
+    using Base::CVar;
+    m_budget = CVar::get_int("pacing", "budget", 10) * 1000;
+    m_maxticks = CVar::get_int(
+        "pacing", "maxticks", Defs::MAXUPDATE / Defs::FRAMETIME);
+    int maxlag = CVar::get_int("pacing", "maxlag", Defs::MAXUPDATE);
+    m_slowmotion = CVar::get_bool("pacing", "slowmotion", false);
+    if (m_budget < 1000)
+        m_budget = 1000;
+    if (m_maxticks < 1)
+        m_maxticks = 1;
+    if (maxlag < Defs::FRAMETIME)
+        maxlag = Defs::FRAMETIME;
+    m_maxlag = maxlag;
+    std::memset(&m_stats, 0, sizeof(m_stats));
+}
+
+unsigned FramePacer::begin_frame(unsigned time) {
+    m_stats.frames++;
+    if (!m_initted) {
+        m_initted = true;
+        m_frametime = time;
+        return 1;
+    }
+
+    unsigned due = (time - m_frametime) / Defs::FRAMETIME;
+    unsigned limit = m_maxticks;
+    if (m_stats.tick_cost > 0.0f) {
+        float fit = (float) m_budget / m_stats.tick_cost;
+        if (fit < 1.0f)
+            limit = 1;
+        else if (fit < (float) limit)
+            limit = (unsigned) fit;
+    }
+
+    unsigned nticks = due;
+    if (nticks > limit) {
+        nticks = limit;
+        m_stats.deferred++;
+    }
+    m_frametime += nticks * Defs::FRAMETIME;
+
+    unsigned lag = time - m_frametime;
+    unsigned maxlag = m_slowmotion ? Defs::FRAMETIME - 1 : m_maxlag;
+    if (lag > maxlag) {
+        unsigned drop = lag - lag % Defs::FRAMETIME;
+        if (!m_slowmotion)
+            Log::warn("lag: dropping %u ms", drop);
+        m_frametime += drop;
+        m_stats.dropped += drop;
+    }
+
+    return nticks;
+}
+
+void FramePacer::end_update(unsigned nticks, long long elapsed) {
+    m_stats.ticks += nticks;
+    m_stats.last_ticks = nticks;
+    if (nticks > m_stats.max_ticks)
+        m_stats.max_ticks = nticks;
+    m_stats.update_time += elapsed;
+    m_stats.last_update_time = elapsed;
+    if (nticks > 0) {
+        float cost = (float) elapsed / (float) nticks;
+        if (m_stats.tick_cost > 0.0f)
+            m_stats.tick_cost += (cost - m_stats.tick_cost) * COST_SMOOTHING;
+        else
+            m_stats.tick_cost = cost;
+    }
+}
+
+void FramePacer::end_draw(long long elapsed) {
+    m_stats.draw_time += elapsed;
+    m_stats.last_draw_time = elapsed;
+}
+
+int FramePacer::delta(unsigned time) const {
+    unsigned delta = time - m_frametime;
+    if (delta > (unsigned) Defs::FRAMETIME)
+        return Defs::FRAMETIME;
+    return (int) delta;
+}
+
+}
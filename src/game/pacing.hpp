@@ -0,0 +1,73 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_GAME_PACING_HPP
+#define LD_GAME_PACING_HPP
+namespace Game {
+
+/// Frame pacing counters.  Times are in microseconds.
+struct FrameStats {
+    /// Number of frames drawn.
+    unsigned frames;
+    /// Number of ticks run.
+    unsigned ticks;
+    /// Number of ticks run in the last frame.
+    unsigned last_ticks;
+    /// Maximum number of ticks run in one frame.
+    unsigned max_ticks;
+    /// Number of frames which ran fewer ticks than were due.
+    unsigned deferred;
+    /// Milliseconds of game time dropped to stay within budget.
+    unsigned dropped;
+    /// Total time spent updating and drawing.
+    long long update_time;
+    long long draw_time;
+    /// Time spent updating and drawing in the last frame.
+    long long last_update_time;
+    long long last_draw_time;
+    /// Smoothed cost of a single tick.
+    float tick_cost;
+};
+
+/// Decide how many fixed-length ticks to run each frame.
+///
+/// Ticks are run until the game catches up with the wall clock, but
+/// at most as many as fit in the update budget, judging by how long
+/// ticks have actually been taking.  Leftover ticks are deferred to
+/// later frames.  If the backlog grows past the maximum lag, the
+/// excess game time is dropped instead.  In slow motion mode, any
+/// ticks that do not fit in the budget are dropped immediately, so
+/// the game slows down smoothly instead of lurching to catch up.
+///
+/// Configured by the pacing.budget (ms), pacing.maxticks,
+/// pacing.maxlag (ms), and pacing.slowmotion cvars.
+class FramePacer {
+private:
+    bool m_initted;
+    unsigned m_frametime;
+    int m_budget;
+    int m_maxticks;
+    unsigned m_maxlag;
+    bool m_slowmotion;
+    FrameStats m_stats;
+
+public:
+    FramePacer();
+
+    /// Start a new frame, returning the number of ticks to run.
+    unsigned begin_frame(unsigned time);
+    /// Record the time spent running the ticks in this frame.
+    void end_update(unsigned nticks, long long elapsed);
+    /// Record the time spent drawing this frame.
+    void end_draw(long long elapsed);
+    /// Get the timestamp of the most recent tick.
+    unsigned frametime() const { return m_frametime; }
+    /// Get the time elapsed since the most recent tick, for
+    /// interpolation.  Always in the range [0, FRAMETIME].
+    int delta(unsigned time) const;
+    /// Get the counters.
+    const FrameStats &stats() const { return m_stats; }
+};
+
+}
+#endif
@@ -0,0 +1,183 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "particles.hpp"
+#include "base/profile.hpp"
+#include <cmath>
+#if defined __SSE2__ || defined _M_X64
+#define LD_PARTICLE_SSE 1
+#include <emmintrin.h>
+#endif
+namespace Game {
+
+namespace {
+
+using ::Graphics::ParticleVert;
+
+/// Behavior of each particle type.  Units are pixels and ticks.
+struct ParticleInfo {
+    Layer layer;
+    float life;
+    float speed;
+    float gravity;
+    float drag;
+    short size;
+};
+
+const ParticleInfo PARTICLE_INFO[::Graphics::PARTICLE_COUNT] = {
+    // SPARKLE
+    { Layer::BOTH, 24.0f, 5.0f, 0.25f, 0.90f, 3 },
+    // PICKUP
+    { Layer::PHYSICAL, 16.0f, 2.5f, -0.10f, 0.85f, 2 },
+    // WAKE
+    { Layer::BOTH, 40.0f, 9.0f, 0.0f, 0.93f, 2 }
+};
+
+// Move particles and age them by one tick.  Padding lanes are
+// updated too, which is harmless.
+void integrate(float *x, float *y, float *vx, float *vy, float *life,
+               std::size_t count, const ParticleInfo &info) {
+    std::size_t i = 0;
+#if defined LD_PARTICLE_SSE
+    __m128 gravity = _mm_set1_ps(info.gravity);
+    __m128 drag = _mm_set1_ps(info.drag);
+    __m128 one = _mm_set1_ps(1.0f);
+    for (; i < count; i += 4) {
+        __m128 dx = _mm_mul_ps(_mm_loadu_ps(vx + i), drag);
+        __m128 dy = _mm_mul_ps(
+            _mm_sub_ps(_mm_loadu_ps(vy + i), gravity), drag);
+        _mm_storeu_ps(vx + i, dx);
+        _mm_storeu_ps(vy + i, dy);
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), dx));
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), dy));
+        _mm_storeu_ps(life + i, _mm_sub_ps(_mm_loadu_ps(life + i), one));
+    }
+#endif
+    for (; i < count; i++) {
+        vx[i] *= info.drag;
+        vy[i] = (vy[i] - info.gravity) * info.drag;
+        x[i] += vx[i];
+        y[i] += vy[i];
+        life[i] -= 1.0f;
+    }
+}
+
+// Convert particles to vertex data, extrapolating backwards from the
+// current position by the fraction of a tick remaining.
+void output(ParticleVert *dest, const float *x, const float *y,
+            const float *vx, const float *vy, const float *life,
+            std::size_t count, const ParticleInfo &info, float frac) {
+    float back = frac - 1.0f, ascale = 255.0f / info.life;
+    std::size_t i = 0;
+#if defined LD_PARTICLE_SSE
+    __m128 vback = _mm_set1_ps(back), vascale = _mm_set1_ps(ascale);
+    __m128i vsize = _mm_set1_epi32(info.size);
+    for (; i + 4 <= count; i += 4) {
+        __m128i px = _mm_cvtps_epi32(_mm_add_ps(
+            _mm_loadu_ps(x + i), _mm_mul_ps(_mm_loadu_ps(vx + i), vback)));
+        __m128i py = _mm_cvtps_epi32(_mm_add_ps(
+            _mm_loadu_ps(y + i), _mm_mul_ps(_mm_loadu_ps(vy + i), vback)));
+        __m128i pa = _mm_cvtps_epi32(
+            _mm_mul_ps(_mm_loadu_ps(life + i), vascale));
+        // Interleave to x, y, alpha, size.
+        __m128i xy = _mm_packs_epi32(px, py);
+        __m128i as = _mm_packs_epi32(pa, vsize);
+        xy = _mm_unpacklo_epi16(xy, _mm_srli_si128(xy, 8));
+        as = _mm_unpacklo_epi16(as, _mm_srli_si128(as, 8));
+        __m128i *out = reinterpret_cast<__m128i *>(dest + i);
+        _mm_storeu_si128(out, _mm_unpacklo_epi32(xy, as));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi32(xy, as));
+    }
+#endif
+    for (; i < count; i++) {
+        dest[i].x = static_cast<short>(std::lrint(x[i] + vx[i] * back));
+        dest[i].y = static_cast<short>(std::lrint(y[i] + vy[i] * back));
+        dest[i].alpha = static_cast<short>(std::lrint(life[i] * ascale));
+        dest[i].size = info.size;
+    }
+}
+
+}
+
+void ParticleSystem::Pool::reserve(std::size_t total) {
+    total = (total + 3) & ~static_cast<std::size_t>(3);
+    if (x.size() >= total)
+        return;
+    x.resize(total);
+    y.resize(total);
+    vx.resize(total);
+    vy.resize(total);
+    life.resize(total);
+}
+
+ParticleSystem::ParticleSystem() {
+    m_rand.x = Base::Random::gnext();
+    m_rand.y = Base::Random::gnext();
+    m_rand.z = Base::Random::gnext();
+    m_rand.w = Base::Random::gnext();
+}
+
+void ParticleSystem::emit(Particle type, FVec pos, int count) {
+    if (count <= 0)
+        return;
+    const ParticleInfo &info = PARTICLE_INFO[static_cast<int>(type)];
+    Pool &pool = m_pool[static_cast<int>(type)];
+    std::size_t n = pool.count;
+    pool.reserve(n + count);
+    const float tau = std::atan(1.0f) * 8.0f;
+    for (int i = 0; i < count; i++) {
+        float angle = m_rand.nextf() * tau;
+        float speed = info.speed * (0.5f + 0.5f * m_rand.nextf());
+        pool.x[n + i] = pos.x;
+        pool.y[n + i] = pos.y;
+        pool.vx[n + i] = std::cos(angle) * speed;
+        pool.vy[n + i] = std::sin(angle) * speed;
+        pool.life[n + i] = info.life * (0.75f + 0.25f * m_rand.nextf());
+    }
+    pool.count = n + count;
+}
+
+void ParticleSystem::update() {
+    Base::ProfileScope scope("ParticleSystem::update");
+    for (int t = 0; t < ::Graphics::PARTICLE_COUNT; t++) {
+        Pool &pool = m_pool[t];
+        std::size_t n = pool.count;
+        if (!n)
+            continue;
+        integrate(pool.x.data(), pool.y.data(), pool.vx.data(),
+                  pool.vy.data(), pool.life.data(), n, PARTICLE_INFO[t]);
+
+        // Remove dead particles, order does not matter.
+        std::size_t i = 0;
+        while (i < n) {
+            if (pool.life[i] > 0.0f) {
+                i++;
+                continue;
+            }
+            n--;
+            pool.x[i] = pool.x[n];
+            pool.y[i] = pool.y[n];
+            pool.vx[i] = pool.vx[n];
+            pool.vy[i] = pool.vy[n];
+            pool.life[i] = pool.life[n];
+        }
+        pool.count = n;
+    }
+}
+
+void ParticleSystem::draw(::Graphics::Frame &gr, int delta) const {
+    Base::ProfileScope scope("ParticleSystem::draw");
+    float frac = delta * (1.0f / Defs::FRAMETIME);
+    for (int t = 0; t < ::Graphics::PARTICLE_COUNT; t++) {
+        const Pool &pool = m_pool[t];
+        if (!pool.count)
+            continue;
+        const ParticleInfo &info = PARTICLE_INFO[t];
+        ParticleVert *dest = gr.add_particles(
+            static_cast<Particle>(t), info.layer, pool.count);
+        output(dest, pool.x.data(), pool.y.data(), pool.vx.data(),
+               pool.vy.data(), pool.life.data(), pool.count, info, frac);
+    }
+}
+
+}
@@ -0,0 +1,46 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_GAME_PARTICLES_HPP
+#define LD_GAME_PARTICLES_HPP
+#include "defs.hpp"
+#include "base/random.hpp"
+#include "graphics/particle.hpp"
+#include <vector>
+namespace Game {
+typedef ::Graphics::Particle Particle;
+
+/// Particle effects, updated on the fixed tick.  Particles are stored
+/// as a structure of arrays for each particle type, so they can be
+/// updated four at a time.
+class ParticleSystem {
+private:
+    struct Pool {
+        // Arrays are padded to a multiple of four elements.
+        std::vector<float> x, y, vx, vy, life;
+        std::size_t count;
+
+        Pool() : count(0) { }
+        void reserve(std::size_t total);
+    };
+
+    Pool m_pool[::Graphics::PARTICLE_COUNT];
+    Base::Random m_rand;
+
+public:
+    ParticleSystem();
+
+    /// Emit a burst of particles from a point.
+    void emit(Particle type, FVec pos, int count);
+    /// Advance all particles by one tick.
+    void update();
+    /// Draw all particles.
+    void draw(::Graphics::Frame &gr, int delta) const;
+    /// Get the number of live particles of one type.
+    std::size_t count(Particle type) const {
+        return m_pool[static_cast<int>(type)].count;
+    }
+};
+
+}
+#endif
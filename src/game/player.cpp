@@ -131,7 +131,7 @@ void Player::update() {
     }
 }
 
-void Player::draw(::Graphics::System &gr, int delta) const {
+void Player::draw(::Graphics::Frame &gr, int delta) const {
     gr.add_sprite(
         Sprite::GIRL,
         m_mover.drawpos(delta),
@@ -151,7 +151,9 @@ void Player::draw(::Graphics::System &gr, int delta) const {
                 gr.add_sprite(
                     Sprite::SELECTION,
                     pos,
-                    Layer::INTERFACE);
+                    Layer::INTERFACE,
+                    Orientation::NORMAL,
+                    DEPTH_FRONT);
             }
         }
     }
@@ -169,7 +171,9 @@ void Player::draw(::Graphics::System &gr, int delta) const {
             line.speaker == 0 ? Sprite::TALKG1 : Sprite::TALKS1,
             IVec(CENTER - 256 + MARGIN + PWIDTH / 2,
                  MARGIN + PWIDTH / 2),
-            Layer::INTERFACE);
+            Layer::INTERFACE,
+            Orientation::NORMAL,
+            DEPTH_FRONT);
         gr.put_text(
             IVec(CENTER - 256 + PWIDTH + MARGIN * 2, PWIDTH + MARGIN),
             Graphics::HAlign::LEFT,
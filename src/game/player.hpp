@@ -26,7 +26,7 @@ public:
     virtual ~Player();
 
     virtual void update();
-    virtual void draw(::Graphics::System &gr, int delta) const;
+    virtual void draw(::Graphics::Frame &gr, int delta) const;
 
 private:
     void hit_item(Item &item);
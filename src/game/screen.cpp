@@ -15,4 +15,8 @@ void Screen::update(unsigned time) {
     (void) time;
 }
 
+void Screen::reload_level(int level) {
+    (void) level;
+}
+
 }
@@ -4,7 +4,7 @@
 #ifndef LD_GAME_SCREEN_HPP
 #define LD_GAME_SCREEN_HPP
 namespace Graphics {
-class System;
+class Frame;
 }
 namespace Game {
 class ControlState;
@@ -20,8 +20,11 @@ public:
     virtual ~Screen();
     Screen &operator=(const Screen &) = delete;
     Screen &operator=(Screen &&) = delete;
-    virtual void draw(::Graphics::System &gr, int delta) = 0;
+    virtual void draw(::Graphics::Frame &gr, int delta) = 0;
     virtual void update(unsigned time);
+    /// Reload the level data from disk, if this screen shows the
+    /// given level.
+    virtual void reload_level(int level);
     const ControlState &control() const { return m_control; }
 };
 
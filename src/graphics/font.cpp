@@ -0,0 +1,332 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "font.hpp"
+#include "base/file.hpp"
+#include "base/log.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+namespace Graphics {
+
+using Base::Log;
+
+namespace {
+
+const std::size_t MAX_SIZE = 1024 * 256;
+
+// Glyph index meaning "no glyph", for kerning at the start of a line.
+const unsigned short NO_GLYPH = 0xffff;
+
+// Code point for malformed UTF-8.
+const unsigned REPLACEMENT = 0xfffd;
+
+// Attributes of one line in a BMFont descriptor.
+struct Tag {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> attr;
+
+    void parse(const char *ptr, const char *end);
+    const std::string *get(const char *key) const;
+    int get_int(const char *key) const;
+};
+
+void Tag::parse(const char *ptr, const char *end) {
+    name.clear();
+    attr.clear();
+    while (ptr != end && *ptr != ' ')
+        name += *ptr++;
+    while (true) {
+        while (ptr != end && (*ptr == ' ' || *ptr == '\r'))
+            ptr++;
+        if (ptr == end)
+            break;
+        const char *kstart = ptr;
+        while (ptr != end && *ptr != '=' && *ptr != ' ')
+            ptr++;
+        std::string key(kstart, ptr), value;
+        if (ptr != end && *ptr == '=') {
+            ptr++;
+            if (ptr != end && *ptr == '"') {
+                const char *vstart = ++ptr;
+                while (ptr != end && *ptr != '"')
+                    ptr++;
+                value.assign(vstart, ptr);
+                if (ptr != end)
+                    ptr++;
+            } else {
+                const char *vstart = ptr;
+                while (ptr != end && *ptr != ' ' && *ptr != '\r')
+                    ptr++;
+                value.assign(vstart, ptr);
+            }
+        }
+        attr.push_back(std::make_pair(std::move(key), std::move(value)));
+    }
+}
+
+const std::string *Tag::get(const char *key) const {
+    for (auto &a : attr) {
+        if (a.first == key)
+            return &a.second;
+    }
+    return nullptr;
+}
+
+int Tag::get_int(const char *key) const {
+    auto value = get(key);
+    if (!value)
+        Log::abort("font: '%s' missing '%s'", name.c_str(), key);
+    char *end;
+    long x = std::strtol(value->c_str(), &end, 10);
+    if (value->empty() || *end ||
+        x < std::numeric_limits<short>::min() ||
+        x > std::numeric_limits<short>::max())
+        Log::abort("font: invalid '%s' in '%s'", key, name.c_str());
+    return static_cast<int>(x);
+}
+
+}
+
+Font::Font()
+    : m_line_height(0) {
+    for (int i = 0; i < 128; i++)
+        m_ascii[i] = 0;
+}
+
+void Font::load(const std::string &path) {
+    Base::Data filedata;
+    filedata.read(path + ".fnt", MAX_SIZE);
+
+    m_glyph.clear();
+    m_map.clear();
+    m_kerning.clear();
+    for (int i = 0; i < 128; i++)
+        m_ascii[i] = 0;
+    m_line_height = 0;
+    m_page.clear();
+
+    // Glyph 0 is used for missing characters.
+    Glyph missing = { 0, 0, 0, 0, 0, 0, 0 };
+    m_glyph.push_back(missing);
+
+    std::vector<std::pair<unsigned, int>> kerning;
+    const char *ptr = static_cast<const char *>(filedata.ptr());
+    const char *end = ptr + filedata.size();
+    Tag tag;
+    while (ptr != end) {
+        const char *nl = static_cast<const char *>(
+            std::memchr(ptr, '\n', end - ptr));
+        const char *eol = nl ? nl : end;
+        tag.parse(ptr, eol);
+        ptr = nl ? nl + 1 : end;
+
+        if (tag.name == "common") {
+            m_line_height = tag.get_int("lineHeight");
+            if (tag.get_int("pages") != 1)
+                Log::abort("font %s: only one page is supported",
+                           path.c_str());
+        } else if (tag.name == "page") {
+            auto file = tag.get("file");
+            if (!file)
+                Log::abort("font %s: page has no file", path.c_str());
+            // The page is relative to the descriptor, and loaded
+            // without its extension.
+            std::string::size_type slash = path.rfind('/');
+            m_page = slash == std::string::npos ?
+                std::string() : path.substr(0, slash + 1);
+            m_page += file->substr(0, file->rfind('.'));
+        } else if (tag.name == "char") {
+            int id = tag.get_int("id");
+            if (id < 0)
+                continue;
+            if (m_glyph.size() >= NO_GLYPH)
+                Log::abort("font %s: too many glyphs", path.c_str());
+            Glyph g;
+            g.x = tag.get_int("x");
+            g.y = tag.get_int("y");
+            g.width = tag.get_int("width");
+            g.height = tag.get_int("height");
+            g.xoffset = tag.get_int("xoffset");
+            g.yoffset = tag.get_int("yoffset");
+            g.advance = tag.get_int("xadvance");
+            auto index = static_cast<unsigned short>(m_glyph.size());
+            m_glyph.push_back(g);
+            if (id < 128)
+                m_ascii[id] = index;
+            else
+                m_map[id] = index;
+        } else if (tag.name == "kerning") {
+            int first = tag.get_int("first"), second = tag.get_int("second");
+            int amount = tag.get_int("amount");
+            if (first >= 0 && first < 0x10000 && second >= 0 &&
+                second < 0x10000 && amount)
+                kerning.push_back(std::make_pair(
+                    (static_cast<unsigned>(first) << 16) |
+                    static_cast<unsigned>(second), amount));
+        }
+    }
+
+    if (m_line_height <= 0 || m_page.empty())
+        Log::abort("font %s: missing common or page", path.c_str());
+
+    unsigned short q = glyph('?');
+    m_glyph[0] = m_glyph[q];
+
+    // Kerning is stored by glyph index, not by code point.
+    for (auto &k : kerning) {
+        unsigned short first = glyph(k.first >> 16);
+        unsigned short second = glyph(k.first & 0xffff);
+        if (!first || !second)
+            continue;
+        Kerning kern;
+        kern.pair = (static_cast<unsigned>(first) << 16) | second;
+        kern.amount = static_cast<short>(k.second);
+        m_kerning.push_back(kern);
+    }
+    std::sort(
+        m_kerning.begin(), m_kerning.end(),
+        [](const Kerning &x, const Kerning &y) { return x.pair < y.pair; });
+}
+
+int Font::kerning(unsigned short first, unsigned short second) const {
+    if (m_kerning.empty() || first == NO_GLYPH)
+        return 0;
+    unsigned pair = (static_cast<unsigned>(first) << 16) | second;
+    auto i = std::lower_bound(
+        m_kerning.begin(), m_kerning.end(), pair,
+        [](const Kerning &x, unsigned y) { return x.pair < y; });
+    return i != m_kerning.end() && i->pair == pair ? i->amount : 0;
+}
+
+void Font::decode(const char *str, std::size_t len) {
+    // There are never more code points than bytes.
+    m_text.resize(len);
+    const unsigned char *ptr = reinterpret_cast<const unsigned char *>(str);
+    const unsigned char *end = ptr + len;
+    unsigned *out = m_text.data();
+    while (ptr != end) {
+        // Copy runs of ASCII eight bytes at a time.
+        while (end - ptr >= 8) {
+            std::uint64_t word;
+            std::memcpy(&word, ptr, 8);
+            if (word & UINT64_C(0x8080808080808080))
+                break;
+            for (int i = 0; i < 8; i++)
+                out[i] = ptr[i];
+            out += 8;
+            ptr += 8;
+        }
+        if (ptr == end)
+            break;
+
+        unsigned c = *ptr++;
+        if (c < 0x80) {
+            *out++ = c;
+            continue;
+        }
+        int n;
+        unsigned min;
+        if (c >= 0xc2 && c < 0xe0) {
+            n = 1;
+            c &= 0x1f;
+            min = 0x80;
+        } else if (c >= 0xe0 && c < 0xf0) {
+            n = 2;
+            c &= 0x0f;
+            min = 0x800;
+        } else if (c >= 0xf0 && c < 0xf5) {
+            n = 3;
+            c &= 0x07;
+            min = 0x10000;
+        } else {
+            *out++ = REPLACEMENT;
+            continue;
+        }
+        int i = 0;
+        for (; i < n && ptr != end && (*ptr & 0xc0) == 0x80; i++)
+            c = (c << 6) | (*ptr++ & 0x3f);
+        if (i < n || c < min || c > 0x10ffff ||
+            (c >= 0xd800 && c < 0xe000))
+            c = REPLACEMENT;
+        *out++ = c;
+    }
+    m_text.resize(out - m_text.data());
+}
+
+int Font::layout(std::vector<GlyphPos> &out, HAlign halign, int width,
+                 const char *str, std::size_t len) {
+    decode(str, len);
+    const unsigned *text = m_text.data();
+    const Glyph *glyphs = m_glyph.data();
+    std::size_t pos = 0, n = m_text.size();
+    int line = 0;
+    while (pos != n) {
+        // Find the end of the line.  Lines break at the first space
+        // of a run, and words longer than the width are not split.
+        std::size_t end = pos, brk = n;
+        int x = 0, brkx = 0;
+        unsigned short prev = NO_GLYPH;
+        for (; end != n; end++) {
+            unsigned c = text[end];
+            if (c == '\n')
+                break;
+            if (c == ' ' && (end == pos || text[end - 1] != ' ')) {
+                if (width >= 0 && x > width)
+                    break;
+                brk = end;
+                brkx = x;
+            }
+            unsigned short g = glyph(c);
+            x += kerning(prev, g) + glyphs[g].advance;
+            prev = g;
+        }
+        if (width >= 0 && x > width && brk != n) {
+            end = brk;
+            x = brkx;
+        }
+
+        int offset = 0;
+        switch (halign) {
+        case HAlign::LEFT:
+            break;
+        case HAlign::CENTER:
+            offset = -x / 2;
+            break;
+        case HAlign::RIGHT:
+            offset = -x;
+            break;
+        }
+
+        // Place the visible glyphs.
+        int y = -line * m_line_height;
+        x = offset;
+        prev = NO_GLYPH;
+        for (std::size_t i = pos; i != end; i++) {
+            unsigned short g = glyph(text[i]);
+            const Glyph &gl = glyphs[g];
+            x += kerning(prev, g);
+            if (gl.width > 0 && gl.height > 0) {
+                GlyphPos gp;
+                gp.x = static_cast<short>(x + gl.xoffset);
+                gp.y = static_cast<short>(y - gl.yoffset);
+                gp.glyph = g;
+                out.push_back(gp);
+            }
+            x += gl.advance;
+            prev = g;
+        }
+
+        pos = end;
+        while (pos != n && text[pos] == ' ')
+            pos++;
+        if (pos != n && text[pos] == '\n')
+            pos++;
+        line++;
+    }
+    return line;
+}
+
+}
@@ -0,0 +1,84 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_GRAPHICS_FONT_HPP
+#define LD_GRAPHICS_FONT_HPP
+#include "frame.hpp"
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+namespace Graphics {
+
+/// A glyph in a font atlas.  All metrics are in pixels.
+struct Glyph {
+    // Rectangle in the atlas, with y increasing downwards.
+    short x, y, width, height;
+    // Offset from the pen position to the top left of the glyph.
+    short xoffset, yoffset;
+    // Distance to advance the pen.
+    short advance;
+};
+
+/// A glyph placed by text layout.  The position is the top left
+/// corner, relative to the top left of the text.
+struct GlyphPos {
+    short x, y;
+    unsigned short glyph;
+};
+
+/// A bitmap font with variable width glyphs and kerning.  The metrics
+/// are read from a BMFont text descriptor, with a single atlas page.
+class Font {
+private:
+    struct Kerning {
+        unsigned pair;
+        short amount;
+    };
+
+    std::vector<Glyph> m_glyph;
+    // Glyph indexes for ASCII, and for everything else.
+    unsigned short m_ascii[128];
+    std::unordered_map<unsigned, unsigned short> m_map;
+    // Kerning pairs, sorted by pair.
+    std::vector<Kerning> m_kerning;
+    int m_line_height;
+    std::string m_page;
+
+    // Scratch space for layout.
+    std::vector<unsigned> m_text;
+
+public:
+    Font();
+    Font(const Font &) = delete;
+    Font &operator=(const Font &) = delete;
+
+    /// Load the font descriptor at the given path, without extension.
+    void load(const std::string &path);
+
+    /// Get the path of the atlas image, without extension.
+    const std::string &page() const { return m_page; }
+    /// Get the distance between lines.
+    int line_height() const { return m_line_height; }
+    /// Get the glyphs, indexed by GlyphPos::glyph.
+    const Glyph *glyphs() const { return m_glyph.data(); }
+
+    /// Lay out UTF-8 text, appending the visible glyphs.  Lines are
+    /// wrapped at spaces to fit the width, use -1 for no wrapping.
+    /// Returns the number of lines.
+    int layout(std::vector<GlyphPos> &out, HAlign halign, int width,
+               const char *str, std::size_t len);
+
+private:
+    unsigned short glyph(unsigned cp) const {
+        if (cp < 128)
+            return m_ascii[cp];
+        auto i = m_map.find(cp);
+        return i == m_map.end() ? 0 : i->second;
+    }
+    int kerning(unsigned short first, unsigned short second) const;
+    void decode(const char *str, std::size_t len);
+};
+
+}
+#endif
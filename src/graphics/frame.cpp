@@ -0,0 +1,121 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "frame.hpp"
+#include "base/sprite.hpp"
+#include <atomic>
+namespace Graphics {
+
+using Base::IVec;
+using Base::IRect;
+using Base::Orientation;
+
+Frame::Frame()
+    : m_tile_key(0), m_camera(IVec::zero()), m_visible(IRect::zero()),
+      m_world(0.0f) {
+    for (int i = 0; i < 4; i++)
+        m_noise[i] = 0.0f;
+}
+
+unsigned Frame::new_tile_key() {
+    static std::atomic<unsigned> counter(0);
+    return ++counter;
+}
+
+void Frame::clear() {
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        if (i != static_cast<int>(Layer::TILE))
+            m_sprite[i].clear();
+        m_particle[i].clear();
+    }
+    m_particle_data.clear();
+    m_text.clear();
+    m_chars.clear();
+    m_view.clear();
+}
+
+void Frame::clear_tiles(unsigned key) {
+    m_sprite[static_cast<int>(Layer::TILE)].clear();
+    m_tile_key = key;
+}
+
+void Frame::copy_from(const Frame &other) {
+    if (this == &other)
+        return;
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        if (i != static_cast<int>(Layer::TILE) ||
+            m_tile_key != other.m_tile_key)
+            m_sprite[i] = other.m_sprite[i];
+        m_particle[i] = other.m_particle[i];
+    }
+    m_particle_data = other.m_particle_data;
+    m_tile_key = other.m_tile_key;
+    m_text = other.m_text;
+    m_chars = other.m_chars;
+    m_view = other.m_view;
+    m_camera = other.m_camera;
+    m_visible = other.m_visible;
+    m_world = other.m_world;
+    for (int i = 0; i < 4; i++)
+        m_noise[i] = other.m_noise[i];
+}
+
+void Frame::set_noise(const float noise[4]) {
+    for (int i = 0; i < 4; i++)
+        m_noise[i] = noise[i];
+}
+
+void Frame::add_sprite(AnySprite sp, IVec pos, Layer layer,
+                       Orientation orientation, int z) {
+    SpriteCmd cmd;
+    cmd.sprite = sp;
+    cmd.pos = pos;
+    cmd.orientation = orientation;
+    cmd.z = z;
+    m_sprite[static_cast<int>(layer)].push_back(cmd);
+}
+
+void Frame::add_sprite(AnySprite sp, IVec pos, Layer layer,
+                       Orientation orientation) {
+    add_sprite(sp, pos, layer, orientation, 0);
+}
+
+void Frame::add_sprite(AnySprite sp, IVec pos, Layer layer) {
+    add_sprite(sp, pos, layer, Orientation::NORMAL);
+}
+
+ParticleVert *Frame::add_particles(Particle type, Layer layer,
+                                  std::size_t count) {
+    ParticleCmd cmd;
+    cmd.type = type;
+    cmd.offset = m_particle_data.size();
+    cmd.count = count;
+    m_particle[static_cast<int>(layer)].push_back(cmd);
+    m_particle_data.resize(cmd.offset + count);
+    return m_particle_data.data() + cmd.offset;
+}
+
+void Frame::put_text(IVec pos, HAlign halign, VAlign valign, int width,
+                     Color color, const std::string &str) {
+    TextCmd cmd;
+    cmd.pos = pos;
+    cmd.halign = halign;
+    cmd.valign = valign;
+    cmd.width = width;
+    cmd.color = color;
+    cmd.offset = m_chars.size();
+    cmd.length = str.size();
+    m_chars += str;
+    m_text.push_back(cmd);
+}
+
+void Frame::add_view(IRect rect, IVec camera, int scale, float world) {
+    ViewCmd cmd;
+    cmd.rect = rect;
+    cmd.camera = camera;
+    cmd.scale = scale > 0 ? scale : 1;
+    cmd.world = world;
+    m_view.push_back(cmd);
+}
+
+}
@@ -0,0 +1,159 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_GRAPHICS_FRAME_HPP
+#define LD_GRAPHICS_FRAME_HPP
+#include "color.hpp"
+#include "layer.hpp"
+#include "particle.hpp"
+#include "sprite.hpp"
+#include "base/vec.hpp"
+#include <string>
+#include <vector>
+namespace Base {
+enum class Orientation;
+}
+namespace Graphics {
+
+enum class HAlign { LEFT, CENTER, RIGHT };
+enum class VAlign { BOTTOM, CENTER, TOP };
+
+/// A snapshot of everything drawn in one frame.  Screens record into
+/// a frame, and the graphics system builds its vertex data from it.
+/// Frames contain no OpenGL objects, so they can be recorded on any
+/// thread.
+///
+/// The tile layer is retained between frames.  It is tagged with a
+/// key, and only rebuilt by the graphics system when the key changes.
+class Frame {
+public:
+    struct SpriteCmd {
+        AnySprite sprite;
+        Base::IVec pos;
+        Base::Orientation orientation;
+        int z;
+    };
+
+    struct ParticleCmd {
+        Particle type;
+        std::size_t offset;
+        std::size_t count;
+    };
+
+    struct TextCmd {
+        Base::IVec pos;
+        HAlign halign;
+        VAlign valign;
+        int width;
+        Color color;
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    /// An additional view of the world, drawn over the main view but
+    /// under the interface.
+    struct ViewCmd {
+        /// The screen rectangle covered by the view.
+        Base::IRect rect;
+        /// The lower-left corner of the view, in world coordinates.
+        Base::IVec camera;
+        /// World pixels per screen pixel.
+        int scale;
+        /// The world shown in the view, 0 for reality, 1 for dreams.
+        float world;
+    };
+
+private:
+    unsigned m_tile_key;
+    std::vector<SpriteCmd> m_sprite[LAYER_COUNT];
+    std::vector<ParticleCmd> m_particle[LAYER_COUNT];
+    std::vector<ParticleVert> m_particle_data;
+    std::vector<TextCmd> m_text;
+    std::string m_chars;
+    std::vector<ViewCmd> m_view;
+    Base::IVec m_camera;
+    Base::IRect m_visible;
+    float m_world;
+    float m_noise[4];
+
+public:
+    Frame();
+
+    /// Generate a new unique key for tile data.
+    static unsigned new_tile_key();
+
+    /// Clear everything except the tile layer.
+    void clear();
+    /// Clear the tile layer, and tag the tiles which will be added
+    /// with the given key.
+    void clear_tiles(unsigned key);
+    /// Copy the contents of another frame.  Tiles are only copied if
+    /// their key differs.
+    void copy_from(const Frame &other);
+
+    /// Set the lower-left corner of the camera.
+    void set_camera(Base::IVec pos) { m_camera = pos; }
+    /// Set the area of the world which can appear on screen, relative
+    /// to the camera.  This is set before a screen draws, so it can
+    /// skip anything outside.
+    void set_visible(Base::IRect rect) { m_visible = rect; }
+    /// Get the area of the world which can appear on screen, relative
+    /// to the camera, or an empty rectangle if unknown.
+    Base::IRect visible() const { return m_visible; }
+    /// Set the current world, or in between.
+    void set_world(float world) { m_world = world; }
+    /// Set the noise offsets.
+    void set_noise(const float noise[4]);
+    /// Add a sprite to the world.  Within a layer, sprites with
+    /// greater depth are drawn on top, and sprites with the same depth
+    /// are drawn in the order they are added.
+    void add_sprite(AnySprite sp, Base::IVec pos, Layer layer,
+                    Base::Orientation orientation, int z);
+    /// Add a sprite to the world.
+    void add_sprite(AnySprite sp, Base::IVec pos, Layer layer,
+                    Base::Orientation orientation);
+    /// Add a sprite to the world.
+    void add_sprite(AnySprite sp, Base::IVec pos, Layer layer);
+    /// Add particles to a layer.  Returns a pointer to the particles,
+    /// which must be filled in before anything else is added.
+    ParticleVert *add_particles(Particle type, Layer layer,
+                                std::size_t count);
+    /// Put text on the screen.  Width is measured in pixels, use -1
+    /// for unlimited width.  The point specified is on the edge of
+    /// the text's bounding box.
+    void put_text(Base::IVec pos, HAlign halign, VAlign valign, int width,
+                  Color color, const std::string &str);
+    /// Add an additional view of the world.  The view draws the
+    /// same sprites as the main view.
+    void add_view(Base::IRect rect, Base::IVec camera, int scale,
+                  float world);
+
+    /// Get the key for the tile layer, or 0 if there are no tiles.
+    unsigned tile_key() const { return m_tile_key; }
+    /// Get the sprites in a layer.
+    const std::vector<SpriteCmd> &sprites(Layer layer) const {
+        return m_sprite[static_cast<int>(layer)];
+    }
+    /// Get the particle groups in a layer.
+    const std::vector<ParticleCmd> &particles(Layer layer) const {
+        return m_particle[static_cast<int>(layer)];
+    }
+    /// Get the particles in a group.
+    const ParticleVert *particle_data(const ParticleCmd &cmd) const {
+        return m_particle_data.data() + cmd.offset;
+    }
+    /// Get the text runs.
+    const std::vector<TextCmd> &text() const { return m_text; }
+    /// Get the characters of a text run.
+    const char *text_chars(const TextCmd &cmd) const {
+        return m_chars.data() + cmd.offset;
+    }
+    /// Get the additional views.
+    const std::vector<ViewCmd> &views() const { return m_view; }
+    Base::IVec camera() const { return m_camera; }
+    float world() const { return m_world; }
+    const float *noise() const { return m_noise; }
+};
+
+}
+#endif
@@ -25,5 +25,11 @@ enum class Layer {
 
 static const int LAYER_COUNT = 5;
 
+/// Sprite depths within a layer.  Sprites with greater depth are
+/// drawn on top.
+static const int DEPTH_BACK = -1;
+static const int DEPTH_NORMAL = 0;
+static const int DEPTH_FRONT = 1;
+
 }
 #endif
@@ -0,0 +1,34 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_GRAPHICS_PARTICLE_HPP
+#define LD_GRAPHICS_PARTICLE_HPP
+namespace Graphics {
+
+/// Types of particles.  All particles of one type in one layer are
+/// drawn with a single draw call.
+enum class Particle {
+    /// Sparkles when a minion is captured.
+    SPARKLE,
+
+    /// Glints when a key is picked up.
+    PICKUP,
+
+    /// Dust blown outwards when waking up from the dream.
+    WAKE
+};
+
+static const int PARTICLE_COUNT = 3;
+
+/// The per-particle data drawn by the graphics system.
+struct ParticleVert {
+    /// Center, in world or screen coordinates.
+    short x, y;
+    /// Opacity, 0 to 255.
+    short alpha;
+    /// Width and height, in pixels.
+    short size;
+};
+
+}
+#endif
@@ -3,9 +3,26 @@
    of the 2-clause BSD license.  For more information, see LICENSE.txt. */
 #include "shader.hpp"
 using Base::ShaderField;
+using Base::BlockField;
+using Base::BlockType;
 namespace Shader {
 
 #define FIELD(n) { #n, offsetof(TYPE, n) }
+#define BLOCK_FIELD(n, t) { #n, BlockType::t, offsetof(TYPE, n) }
+
+#define TYPE FrameBlock
+const BlockField FrameBlock::FIELDS[] = {
+    BLOCK_FIELD(u_blendcolor, VEC4),
+    BLOCK_FIELD(u_blendscale, VEC4),
+    BLOCK_FIELD(u_noiseoffset, VEC4),
+    BLOCK_FIELD(u_backgroundxform, VEC4),
+    BLOCK_FIELD(u_pixscale, VEC2),
+    BLOCK_FIELD(u_noisescale, VEC2),
+    BLOCK_FIELD(u_scale, VEC2),
+    BLOCK_FIELD(u_world, FLOAT),
+    { nullptr, BlockType::FLOAT, 0 }
+};
+#undef TYPE
 
 #define TYPE Plain
 const ShaderField Plain::UNIFORMS[] = {
@@ -35,6 +52,20 @@ const ShaderField Sprite::ATTRIBUTES[] = {
 };
 #undef TYPE
 
+#define TYPE Particle
+const ShaderField Particle::UNIFORMS[] = {
+    FIELD(u_vertxform),
+    FIELD(u_color),
+    { nullptr, 0 }
+};
+
+const ShaderField Particle::ATTRIBUTES[] = {
+    FIELD(a_corner),
+    FIELD(a_particle),
+    { nullptr, 0 }
+};
+#undef TYPE
+
 #define TYPE Text
 const ShaderField Text::UNIFORMS[] = {
     FIELD(u_vertxform),
@@ -55,7 +86,6 @@ const ShaderField Text::ATTRIBUTES[] = {
 const ShaderField Scale::UNIFORMS[] = {
     FIELD(u_picture),
     FIELD(u_pattern),
-    FIELD(u_pixscale),
     { nullptr, 0 }
 };
 
@@ -65,17 +95,35 @@ const ShaderField Scale::ATTRIBUTES[] = {
 };
 #undef TYPE
 
+#define TYPE ScaleNearest
+const ShaderField ScaleNearest::UNIFORMS[] = {
+    FIELD(u_picture),
+    { nullptr, 0 }
+};
+
+const ShaderField ScaleNearest::ATTRIBUTES[] = {
+    FIELD(a_vert),
+    { nullptr, 0 }
+};
+#undef TYPE
+
+#define TYPE ScaleSharp
+const ShaderField ScaleSharp::UNIFORMS[] = {
+    FIELD(u_picture),
+    { nullptr, 0 }
+};
+
+const ShaderField ScaleSharp::ATTRIBUTES[] = {
+    FIELD(a_vert),
+    { nullptr, 0 }
+};
+#undef TYPE
+
 #define TYPE Dream
 const ShaderField Dream::UNIFORMS[] = {
     FIELD(u_reality),
     FIELD(u_noise),
-    FIELD(u_world),
     FIELD(u_background),
-    FIELD(u_color),
-    FIELD(u_blendscale),
-    FIELD(u_noisescale),
-    FIELD(u_noiseoffset),
-    FIELD(u_backgroundxform),
     { nullptr, 0 }
 };
 
@@ -85,4 +133,34 @@ const ShaderField Dream::ATTRIBUTES[] = {
 };
 #undef TYPE
 
+#define TYPE Transition
+const ShaderField Transition::UNIFORMS[] = {
+    FIELD(u_picture),
+    FIELD(u_center),
+    FIELD(u_time),
+    FIELD(u_maxradius),
+    { nullptr, 0 }
+};
+
+const ShaderField Transition::ATTRIBUTES[] = {
+    FIELD(a_vert),
+    { nullptr, 0 }
+};
+#undef TYPE
+
+#define TYPE DreamScale
+const ShaderField DreamScale::UNIFORMS[] = {
+    FIELD(u_reality),
+    FIELD(u_noise),
+    FIELD(u_background),
+    FIELD(u_pattern),
+    { nullptr, 0 }
+};
+
+const ShaderField DreamScale::ATTRIBUTES[] = {
+    FIELD(a_vert),
+    { nullptr, 0 }
+};
+#undef TYPE
+
 }
@@ -6,6 +6,23 @@
 #include "base/shader.hpp"
 namespace Shader {
 
+/// Uniforms shared by every program, updated once per frame.  The
+/// layout must match std140.
+struct FrameBlock {
+    static const Base::BlockField FIELDS[];
+    static const GLuint BINDING = 0;
+
+    float u_blendcolor[4];
+    float u_blendscale[4];
+    float u_noiseoffset[4];
+    float u_backgroundxform[4];
+    float u_pixscale[2];
+    float u_noisescale[2];
+    float u_scale[2];
+    float u_world;
+    float pad;
+};
+
 /// Uniforms and attributes for the "plain" shader.
 struct Plain {
     static const Base::ShaderField UNIFORMS[];
@@ -28,6 +45,17 @@ struct Sprite {
     GLint u_color;
 };
 
+/// Uniforms and attributes for the "particle" shader.
+struct Particle {
+    static const Base::ShaderField UNIFORMS[];
+    static const Base::ShaderField ATTRIBUTES[];
+
+    GLint a_corner;
+    GLint a_particle;
+    GLint u_vertxform;
+    GLint u_color;
+};
+
 /// Uniforms and attributes for the "text" shader.
 struct Text {
     static const Base::ShaderField UNIFORMS[];
@@ -50,7 +78,26 @@ struct Scale {
 
     GLint u_picture;
     GLint u_pattern;
-    GLint u_pixscale;
+};
+
+/// Uniforms and attributes for the "scale_nearest" shader.
+struct ScaleNearest {
+    static const Base::ShaderField UNIFORMS[];
+    static const Base::ShaderField ATTRIBUTES[];
+
+    GLint a_vert;
+
+    GLint u_picture;
+};
+
+/// Uniforms and attributes for the "scale_sharp" shader.
+struct ScaleSharp {
+    static const Base::ShaderField UNIFORMS[];
+    static const Base::ShaderField ATTRIBUTES[];
+
+    GLint a_vert;
+
+    GLint u_picture;
 };
 
 /// Uniforms and attributes for the "dream" shader.
@@ -63,13 +110,32 @@ struct Dream {
     GLint u_reality;
     GLint u_noise;
     GLint u_background;
+};
 
-    GLint u_world;
-    GLint u_color;
-    GLint u_blendscale;
-    GLint u_noisescale;
-    GLint u_noiseoffset;
-    GLint u_backgroundxform;
+/// Uniforms and attributes for the "transition" shader.
+struct Transition {
+    static const Base::ShaderField UNIFORMS[];
+    static const Base::ShaderField ATTRIBUTES[];
+
+    GLint a_vert;
+
+    GLint u_picture;
+    GLint u_center;
+    GLint u_time;
+    GLint u_maxradius;
+};
+
+/// Uniforms and attributes for the "dream_scale" shader.
+struct DreamScale {
+    static const Base::ShaderField UNIFORMS[];
+    static const Base::ShaderField ATTRIBUTES[];
+
+    GLint a_vert;
+
+    GLint u_reality;
+    GLint u_noise;
+    GLint u_background;
+    GLint u_pattern;
 };
 
 }
@@ -4,13 +4,22 @@
 #include "system.hpp"
 
 #include "color.hpp"
+#include "font.hpp"
+#include "frame.hpp"
 #include "layer.hpp"
+#include "particle.hpp"
 #include "shader.hpp"
 #include "sprite.hpp"
+#include "target.hpp"
+#include "timer.hpp"
 
 #include "base/array.hpp"
+#include "base/asset.hpp"
+#include "base/cvar.hpp"
 #include "base/image.hpp"
 #include "base/log.hpp"
+#include "base/opengl.hpp"
+#include "base/profile.hpp"
 #include "base/shader.hpp"
 #include "base/sprite.hpp"
 #include "base/vec.hpp"
@@ -36,6 +45,7 @@ using Base::SpriteSheet;
 using Base::SpriteArray;
 using Base::Orientation;
 using Base::Texture;
+using Base::ProfileScope;
 
 namespace {
 
@@ -63,7 +73,110 @@ void make_fullscreen_quad(Array<float[4]> &arr, FRect tex) {
     data[3][0] = -1.0f; data[3][1] = +1.0f; data[3][2] = u0; data[3][3] = v1;
     data[4][0] = +1.0f; data[4][1] = -1.0f; data[4][2] = u1; data[4][3] = v0;
     data[5][0] = +1.0f; data[5][1] = +1.0f; data[5][2] = u1; data[5][3] = v1;
-    arr.upload(GL_DYNAMIC_DRAW);
+    arr.upload(GL_STATIC_DRAW);
+}
+
+/// Filters for scaling the composite up to the screen.
+static const int SCALE_FILTER_COUNT = 3;
+enum class ScaleFilter {
+    // Nearest neighbor.
+    NEAREST,
+    // Nearest neighbor, with linear filtering at texel edges.  This
+    // is the same as NEAREST when the scale is an integer.
+    SHARP,
+    // Nearest neighbor, modulated by the Hilbert curve pattern.
+    PATTERN
+};
+
+/// Names of the scale filters, for the graphics.scale cvar.
+const char *const SCALE_FILTER_NAME[SCALE_FILTER_COUNT] = {
+    "nearest", "sharp", "pattern"
+};
+
+/// GPU timer names for each scale filter.
+const char *const SCALE_FILTER_GPU_NAME[SCALE_FILTER_COUNT] = {
+    "gpu: scale nearest", "gpu: scale sharp", "gpu: scale pattern"
+};
+
+ScaleFilter get_scale_filter() {
+    std::string name = Base::CVar::get_string(
+        "graphics", "scale", SCALE_FILTER_NAME[
+            static_cast<int>(ScaleFilter::PATTERN)]);
+    for (int i = 0; i < SCALE_FILTER_COUNT; i++) {
+        if (name == SCALE_FILTER_NAME[i])
+            return static_cast<ScaleFilter>(i);
+    }
+    Log::warn("unknown scale filter: %s", name.c_str());
+    return ScaleFilter::PATTERN;
+}
+
+/// Minimum margin around the visible area of the layer targets, which
+/// the dream distortion may read.
+const int TARGET_MARGIN = 64;
+
+/// Names of the noise quality tiers, for the graphics.noise cvar.
+/// The index is the NOISE_QUALITY shader macro.
+static const int NOISE_QUALITY_COUNT = 3;
+const char *const NOISE_QUALITY_NAME[NOISE_QUALITY_COUNT] = {
+    "texture", "low", "high"
+};
+
+/// Size of the noise texture, which the procedural noise matches.
+/// Shaders get this as the NOISE_PERIOD macro.
+const int NOISE_PERIOD = 128;
+
+int get_noise_quality() {
+    std::string name = Base::CVar::get_string(
+        "graphics", "noise", NOISE_QUALITY_NAME[0]);
+    int quality = 0;
+    for (int i = 0; i < NOISE_QUALITY_COUNT; i++) {
+        if (name == NOISE_QUALITY_NAME[i])
+            quality = i;
+    }
+    if (name != NOISE_QUALITY_NAME[quality])
+        Log::warn("unknown noise quality: %s", name.c_str());
+    Base::set_shader_define("NOISE_QUALITY", quality);
+    Base::set_shader_define("NOISE_PERIOD", NOISE_PERIOD);
+    return quality;
+}
+
+/// Profiler scope names for drawing each layer.
+const char *const SPRITE_DRAW_NAME[LAYER_COUNT] = {
+    "sprite_draw: tile",
+    "sprite_draw: physical",
+    "sprite_draw: dream",
+    "sprite_draw: both",
+    "sprite_draw: interface"
+};
+
+/// Palette colors of each particle type, and whether they are additive.
+struct ParticleStyle {
+    int palette;
+    bool additive;
+};
+
+const ParticleStyle PARTICLE_STYLE[PARTICLE_COUNT] = {
+    { 19, true },
+    { 8, true },
+    { 20, false }
+};
+
+static_assert(sizeof(ParticleVert) == sizeof(short[4]),
+              "particle data must match the vertex array");
+
+IVec lerp(IVec a, IVec b, float frac) {
+    return IVec(FVec(a) + (FVec(b) - FVec(a)) * frac);
+}
+
+template<class T>
+void reload_program(Program<T> &prog, const std::string &name) {
+    if (!prog.uses(name))
+        return;
+    if (prog.reload())
+        Log::info("reloaded shader: %s", name.c_str());
+    else
+        Log::error("could not reload shader, keeping old program: %s",
+                   name.c_str());
 }
 
 }
@@ -75,20 +188,69 @@ struct System::Data {
         unsigned length;
     };
 
+    struct ParticleRun {
+        Particle type;
+        unsigned first;
+        unsigned count;
+    };
+
+    struct View {
+        IRect rect;
+        IVec camera;
+        int scale;
+        float world;
+        // Viewport in the target, and transform from world coordinates.
+        IRect viewport;
+        float xform[4];
+    };
+
+    // Noise quality, must precede the shader programs.  Zero uses the
+    // noise texture, otherwise noise is computed in the shader.
+    int m_noise_quality;
+
+    // Uniforms shared by the shader programs, must precede them.
+    Base::UniformBlock m_frame_block;
+
     // Shader programs
     Program<Shader::Sprite> m_prog_sprite;
     Program<Shader::Dream> m_prog_dream;
     Program<Shader::Scale> m_prog_scale;
+    Program<Shader::ScaleNearest> m_prog_scale_nearest;
+    Program<Shader::ScaleSharp> m_prog_scale_sharp;
+    Program<Shader::DreamScale> m_prog_dream_scale;
+    Program<Shader::Transition> m_prog_transition;
     Program<Shader::Text> m_prog_text;
+    Program<Shader::Particle> m_prog_particle;
 
     // Target textures and framebuffers.
     int m_target_width, m_target_height;
     IRect m_target_rect;
-    GLuint m_target_tex[TARGET_COUNT];
-    GLuint m_target_fbuf[TARGET_COUNT];
+    RenderTarget m_target[TARGET_COUNT];
+    TargetPool m_target_pool;
+    // Window size and camera used to compute the layout below.
+    int m_layout_width, m_layout_height;
+    IVec m_layout_camera;
+    // Position of the visible area in the targets.
+    IVec m_texpos;
 
     // Scale from layer texture coordinates to pixel coordinates.
     float m_pixscale[2];
+    // Filter for scaling the composite to the screen.
+    ScaleFilter m_scale_filter;
+    // Screen pixels per composite pixel.
+    float m_scale[2];
+    // Whether the screen is an integer multiple of the composite size.
+    bool m_scale_integer;
+    // Current filter parameter of the composite texture.
+    GLint m_composite_filter;
+    // Whether the dream and scale passes may be merged.
+    bool m_merge;
+    // The previous scene during a transition, or zero.  The picture
+    // is captured from the composite target after the next frame if
+    // m_transition_capture is set.
+    RenderTarget m_transition_target;
+    bool m_transition_capture;
+    float m_transition;
     // Scale for the blending effect.
     float m_blendscale[4];
     /// Translate to background texture coordinates.
@@ -97,6 +259,8 @@ struct System::Data {
     // Sprite transformation from screen or world coordinates.
     float m_xform_screen[4];
     float m_xform_world[4];
+    // Sprite transformation from screen coordinates to the window.
+    float m_xform_window[4];
 
     // Array for layer composition.
     Array<float[4]> m_array_composite;
@@ -106,10 +270,26 @@ struct System::Data {
     // Sprite data
     SpriteSheet m_sprite_sheet;
     SpriteArray m_sprite_array[LAYER_COUNT];
+    // Key of the tiles in the tile layer.
+    unsigned m_tile_key;
 
     // Text data
     Array<short[4]> m_text_array;
     std::vector<TextRun> m_text_run;
+    std::vector<GlyphPos> m_text_glyph;
+
+    // Particle data for all layers, and the runs drawn in each layer.
+    // Without instancing, each particle is repeated for each vertex.
+    bool m_instanced;
+    Array<short[4]> m_particle_array;
+    std::vector<ParticleRun> m_particle_run[LAYER_COUNT];
+    unsigned m_particle_count;
+    // Quad corners, for one particle if instancing, or for every
+    // particle otherwise.
+    Array<short[2]> m_particle_corner;
+
+    // Additional views, which share the sprite arrays.
+    std::vector<View> m_view;
 
     // The blend effect color.
     Color m_blendcolor;
@@ -127,11 +307,15 @@ struct System::Data {
     float m_noiseoffset[4];
 
     // Textures
+    Font m_font_metrics;
     Texture m_font;
     Texture m_pattern;
     Texture m_noise;
     Texture m_background;
 
+    // GPU pass timing.
+    GPUTimer m_timer;
+
     Data();
 
     // ============================================================
@@ -139,6 +323,9 @@ struct System::Data {
     // Set up all layer targets.
     void target_finalize();
 
+    // Compute the quads and transforms which depend on the window size.
+    void target_layout();
+
     // Set the current rendering target.
     void target_set(Target target);
 
@@ -155,126 +342,203 @@ struct System::Data {
 
     // Add a sprite.
     void sprite_add(AnySprite sp, IVec pos,
-                    Orientation orientation,
+                    Orientation orientation, int z,
                     Layer layer);
 
     // Upload sprites.
     void sprite_finalize();
 
-    // Draw a sprite layer.
+    // Draw a sprite layer in the main view.
     void sprite_draw(Layer layer);
 
+    // Draw a sprite layer with the given transform and world.
+    void sprite_draw(Layer layer, const float *xform, float world);
+
     // ============================================================
 
     void text_clear();
 
     void text_put(IVec pos, HAlign halign, VAlign valign, int width,
-                  Color color, const std::string &str);
+                  Color color, const char *str, std::size_t len);
 
     void text_finalize();
 
-    void text_draw();
+    void text_draw(const float *xform);
+
+    // ============================================================
+
+    // Copy the particles from a frame.
+    void particle_set(const Frame &frame);
+
+    // Upload particles.
+    void particle_finalize();
+
+    // Draw the particles in a layer.
+    void particle_draw(Layer layer, const float *xform);
+
+    // ============================================================
+
+    void set_frame(const Frame &prev, const Frame &cur, float frac);
+
+    void add_overlay(const Frame &frame);
 
     // ============================================================
 
-    void draw_layers();
+    // Write the frame uniform block.
+    void frame_update();
+
+    // Determine whether the composite can be drawn in the scale pass.
+    bool can_merge() const;
+
+    void draw_physical();
+
+    void draw_composite();
 
     void draw_reality();
 
+    void draw_views();
+
+    // Draw the previous scene over the composite, during a transition.
+    void draw_transition();
+
     void draw_scaled();
 
+    // Keep the composite target as the transition picture.
+    void transition_capture();
+
+    // Release the transition picture.
+    void transition_end();
+
+    // Draw the composite and scale it to the window in one pass, then
+    // draw the interface over it.
+    void draw_merged();
+
     void draw();
 };
 
 // ============================================================
 
 System::Data::Data()
-    : m_prog_sprite("sprite", "sprite"),
+    : m_noise_quality(get_noise_quality()),
+      m_frame_block("Frame", Shader::FrameBlock::BINDING,
+                    Shader::FrameBlock::FIELDS, sizeof(Shader::FrameBlock)),
+      m_prog_sprite("sprite", "sprite"),
       m_prog_dream("dream", "dream"),
       m_prog_scale("scale", "scale"),
+      m_prog_scale_nearest("scale", "scale_nearest"),
+      m_prog_scale_sharp("scale", "scale_sharp"),
+      m_prog_dream_scale("scale", "dream_scale"),
+      m_prog_transition("scale", "transition"),
       m_prog_text("text", "text"),
+      m_prog_particle("particle", "particle"),
       m_target_width(-1), m_target_height(-1),
-      m_sprite_sheet("", SPRITES),
+      m_layout_width(-1), m_layout_height(-1),
+      m_layout_camera(IVec::zero()),
+      m_texpos(IVec::zero()),
+      m_scale_filter(get_scale_filter()),
+      m_scale_integer(true),
+      m_composite_filter(GL_NEAREST),
+      m_merge(Base::CVar::get_bool("graphics", "merge", false)),
+      m_transition_capture(false),
+      m_transition(0.0f),
+      m_sprite_sheet(),
+      m_tile_key(0),
+      m_instanced(Base::GLInfo::version(3, 3)),
+      m_particle_count(0),
       m_blendcolor(Color::transparent()),
       m_width(-1), m_height(-1),
       m_camera(IVec::zero()),
       m_world(0.0f) {
-    std::memset(m_target_tex, 0, sizeof(m_target_tex));
-    std::memset(m_target_fbuf, 0, sizeof(m_target_fbuf));
+    std::memset(m_target, 0, sizeof(m_target));
+    std::memset(&m_transition_target, 0, sizeof(m_transition_target));
     for (int i = 0; i < 4; i++)
         m_noiseoffset[i] = 0.0f;
-    m_font = Texture::load("font/terminus");
-    m_pattern = Texture::load("misc/hilbert");
-    m_noise = Texture::load("misc/noise");
-    m_background = Texture::load("misc/background");
+    Base::AssetLoader loader("graphics");
+    m_sprite_sheet.load(loader, "", SPRITES, "atlas/sprite");
+    m_font_metrics.load("font/terminus");
+    loader.texture(&m_font, m_font_metrics.page());
+    loader.texture(&m_pattern, "misc/hilbert");
+    if (!m_noise_quality)
+        loader.texture(&m_noise, "misc/noise");
+    loader.texture(&m_background, "misc/background");
+    loader.finish();
 }
 
 // ============================================================
 
 void System::Data::target_finalize() {
-    static const int MARGIN = 64;
     int width = m_width / 2, height = m_height / 2;
+    int fwidth = sg_round_up_pow2_32(width + TARGET_MARGIN * 2);
+    int fheight = sg_round_up_pow2_32(height + TARGET_MARGIN * 2);
+    bool layout = false;
 
-    if (width + MARGIN * 2 > m_target_width ||
-        height + MARGIN * 2 > m_target_height) {
-        glDeleteTextures(TARGET_COUNT, m_target_tex);
-        glDeleteFramebuffers(TARGET_COUNT, m_target_fbuf);
-        int fwidth = sg_round_up_pow2_32(width + MARGIN * 2);
-        int fheight = sg_round_up_pow2_32(height + MARGIN * 2);
-        glGenTextures(TARGET_COUNT, m_target_tex);
-        glGenFramebuffers(TARGET_COUNT, m_target_fbuf);
-
+    if (fwidth != m_target_width || fheight != m_target_height) {
         for (int i = 0; i < TARGET_COUNT; i++) {
-            glBindTexture(GL_TEXTURE_2D, m_target_tex[i]);
-            glTexImage2D(
-                GL_TEXTURE_2D,
-                0,
-                GL_RGBA,
-                fwidth,
-                fheight,
-                0,
-                GL_RGBA,
-                GL_UNSIGNED_BYTE,
-                nullptr);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-            glBindFramebuffer(GL_FRAMEBUFFER, m_target_fbuf[i]);
-            glFramebufferTexture2D(
-                GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                m_target_tex[i], 0);
-            GLenum draw_buffers[1] = { GL_COLOR_ATTACHMENT0 };
-            glDrawBuffers(1, draw_buffers);
-            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
-                GL_FRAMEBUFFER_COMPLETE)
-                Log::abort("cannot render to framebuffer");
+            m_target_pool.release(m_target[i]);
+            m_target[i] = m_target_pool.acquire(fwidth, fheight, GL_RGBA);
         }
-
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // The transition picture no longer lines up with the layout.
+        transition_end();
         m_target_width = fwidth;
         m_target_height = fheight;
         m_pixscale[0] = static_cast<float>(m_target_width);
         m_pixscale[1] = static_cast<float>(m_target_height);
+        m_composite_filter = GL_NEAREST;
+        layout = true;
+    }
+
+    // Everything else only depends on the window size, except the
+    // world transform, which also depends on the camera.
+    if (layout || m_width != m_layout_width ||
+        m_height != m_layout_height) {
+        m_layout_width = m_width;
+        m_layout_height = m_height;
+        target_layout();
+        make_xform(m_xform_world, m_camera - m_texpos,
+                   m_target_width, m_target_height);
+        m_layout_camera = m_camera;
+    } else if (m_camera != m_layout_camera) {
+        make_xform(m_xform_world, m_camera - m_texpos,
+                   m_target_width, m_target_height);
+        m_layout_camera = m_camera;
     }
 
+    for (auto &view : m_view) {
+        view.viewport = IRect(
+            m_texpos.x + view.rect.x0, m_texpos.y + view.rect.y0,
+            m_texpos.x + view.rect.x1, m_texpos.y + view.rect.y1);
+        make_xform(view.xform, view.camera,
+                   view.rect.width() * view.scale,
+                   view.rect.height() * view.scale);
+    }
+
+    sg_opengl_checkerror("TargetManager::set_camera");
+}
+
+void System::Data::target_layout() {
+    int width = m_width / 2, height = m_height / 2;
+
+    m_scale[0] = static_cast<float>(m_width) / static_cast<float>(width);
+    m_scale[1] = static_cast<float>(m_height) / static_cast<float>(height);
+    m_scale_integer = m_width == width * 2 && m_height == height * 2;
+
     IVec texpos((m_target_width - width) / 2,
                 (m_target_height - height) / 2);
+    m_texpos = texpos;
     m_target_rect.x0 = texpos.x;
     m_target_rect.x1 = texpos.x + width;
     m_target_rect.y0 = texpos.y;
     m_target_rect.y1 = texpos.y + height;
-    make_xform(m_xform_world, m_camera - texpos,
-               m_target_width, m_target_height);
     make_xform(m_xform_screen, IVec::zero() - texpos,
                m_target_width, m_target_height);
+    make_xform(m_xform_window, IVec::zero(), width, height);
 
     make_fullscreen_quad(
         m_array_composite,
         FRect(0.0f, 0.0f, 1.0f, 1.0f));
 
-	float xs = static_cast<float>(1.0 / m_target_width);
-	float ys = static_cast<float>(1.0 / m_target_height);
+    float xs = static_cast<float>(1.0 / m_target_width);
+    float ys = static_cast<float>(1.0 / m_target_height);
     make_fullscreen_quad(
         m_array_scale,
         FRect(texpos.x * xs,
@@ -296,18 +560,16 @@ void System::Data::target_finalize() {
     m_bgxform[1] = (-height - texpos.y) * ys;
     m_bgxform[2] = m_background.scale[0] * m_target_width;
     m_bgxform[3] = -m_background.scale[1] * m_target_height;
-
-    sg_opengl_checkerror("TargetManager::set_camera");
 }
 
 void System::Data::target_set(Target target) {
     glBindFramebuffer(GL_FRAMEBUFFER,
-                      m_target_fbuf[static_cast<int>(target)]);
+                      m_target[static_cast<int>(target)].fbuf);
     glViewport(0, 0, m_target_width, m_target_height);
 }
 
 GLuint System::Data::target_texture(Target target) {
-    return m_target_tex[static_cast<int>(target)];
+    return m_target[static_cast<int>(target)].tex;
 }
 
 // ============================================================
@@ -327,11 +589,11 @@ void System::Data::sprite_clear(bool all) {
 }
 
 void System::Data::sprite_add(AnySprite sp, IVec pos,
-                              Orientation orientation,
+                              Orientation orientation, int z,
                               Layer layer) {
     sprite_array(layer).add(
         m_sprite_sheet.get(static_cast<int>(sp)),
-        pos.x, pos.y, orientation);
+        pos.x, pos.y, orientation, z);
 }
 
 void System::Data::sprite_finalize() {
@@ -340,11 +602,20 @@ void System::Data::sprite_finalize() {
 }
 
 void System::Data::sprite_draw(Layer layer) {
+    const float *xform =
+        layer == Layer::INTERFACE ? m_xform_screen : m_xform_world;
+    sprite_draw(layer, xform, m_world);
+    particle_draw(layer, xform);
+}
+
+void System::Data::sprite_draw(Layer layer, const float *xform,
+                               float world) {
     auto &prog = m_prog_sprite;
     auto &arr = sprite_array(layer);
 
     if (arr.empty())
         return;
+    ProfileScope scope(SPRITE_DRAW_NAME[static_cast<int>(layer)]);
 
     glUseProgram(prog.prog());
     glEnableVertexAttribArray(prog->a_vert);
@@ -352,35 +623,24 @@ void System::Data::sprite_draw(Layer layer) {
     glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_sprite_sheet.texture());
-
-    glUniform2fv(prog->u_texscale, 1, m_sprite_sheet.texscale());
     glUniform1i(prog->u_texture, 0);
 
-    const float *xform = nullptr;
     Color color = {{ 1.0, 1.0, 1.0, 1.0 }};
-    switch (layer) {
-    case Layer::TILE:
-    case Layer::PHYSICAL:
-    case Layer::BOTH:
-        xform = m_xform_world;
-        break;
-    case Layer::DREAM:
-        xform = m_xform_world;
-        color = Color::blend(Color::palette(27), color, m_world)
-            .fade(m_world);
+    if (layer == Layer::DREAM) {
+        color = Color::blend(Color::palette(27), color, world)
+            .fade(world);
         color.v[3] = std::sqrt(color.v[3]);
-        break;
-    case Layer::INTERFACE:
-        xform = m_xform_screen;
-        break;
     }
     glUniform4fv(prog->u_vertxform, 1, xform);
     glUniform4fv(prog->u_color, 1, color.v);
 
     arr.set_attrib(prog->a_vert);
-
-    glDrawArrays(GL_TRIANGLES, 0, arr.size());
+    for (const auto &run : arr.runs()) {
+        glBindTexture(GL_TEXTURE_2D, m_sprite_sheet.texture(run.page));
+        glUniform2fv(prog->u_texscale, 1,
+                     m_sprite_sheet.texscale(run.page));
+        glDrawArrays(GL_TRIANGLES, run.first, run.count);
+    }
 
     glUseProgram(0);
     sg_opengl_checkerror("System::Data::sprite_draw");
@@ -394,97 +654,32 @@ void System::Data::text_clear() {
 }
 
 void System::Data::text_put(IVec pos, HAlign halign, VAlign valign, int width,
-                            Color color, const std::string &str) {
-    IVec csz(m_font.iwidth >> 4, m_font.iheight >> 4);
-    int maxc = width >= 0 ?
-        width / csz.x : std::numeric_limits<int>::max();
-
-    if (str.size() > static_cast<size_t>(std::numeric_limits<int>::max()))
+                            Color color, const char *str, std::size_t len) {
+    if (len > static_cast<size_t>(std::numeric_limits<int>::max()))
         Log::abort("string too long");
-    const char *cpos = str.data(), *cend = cpos + str.size();
-    int ypos = 0;
-    unsigned runsize = 0;
-    while (cpos != cend) {
-        // Get the next line of text
-        int rem = static_cast<int>(cend - cpos);
-        const char *line_end;
-        if (rem > maxc) {
-            line_end = nullptr;
-            bool was_white = false;
-            const char *scan = cpos;
-            for (; scan != cpos + maxc; scan++) {
-                if (*scan == '\n') {
-                    line_end = scan;
-                    break;
-                } else if (*scan == ' ') {
-                    if (!was_white) {
-                        line_end = scan;
-                        was_white = true;
-                    }
-                } else {
-                    was_white = false;
-                }
-            }
-            if (!line_end) {
-                for (; scan != cend; scan++) {
-                    if (*scan == '\n' || *scan == ' ')
-                        break;
-                }
-                line_end = scan;
-            }
-        } else {
-            const char *scan = cpos;
-            line_end = cend;
-            for (; scan != cend; scan++) {
-                if (*scan == '\n') {
-                    line_end = scan;
-                    break;
-                }
-            }
-        }
-
-        int line_len = static_cast<int>(line_end - cpos);
-        int offset = 0;
-        switch (halign) {
-        case HAlign::LEFT:
-            break;
-        case HAlign::CENTER:
-            offset = -(line_len * csz.x) / 2;
-            break;
-        case HAlign::RIGHT:
-            offset = -line_len * csz.x;
-            break;
-        }
-
-        for (int i = 0; i < line_len; i++) {
-            unsigned char c = cpos[i];
-            if (c == ' ')
-                continue;
-            short x0 = i * csz.x + offset, x1 = x0 + csz.x;
-            short y1 = -ypos * csz.y, y0 = y1 - csz.y;
-            short u0 = (c & 15), u1 = u0 + 1, v1 = (c >> 4), v0 = v1 + 1;
-            auto d = m_text_array.insert(6);
-            d[0][0] = x0; d[0][1] = y0; d[0][2] = u0; d[0][3] = v0;
-            d[1][0] = x1; d[1][1] = y0; d[1][2] = u1; d[1][3] = v0;
-            d[2][0] = x0; d[2][1] = y1; d[2][2] = u0; d[2][3] = v1;
-            d[3][0] = x0; d[3][1] = y1; d[3][2] = u0; d[3][3] = v1;
-            d[4][0] = x1; d[4][1] = y0; d[4][2] = u1; d[4][3] = v0;
-            d[5][0] = x1; d[5][1] = y1; d[5][2] = u1; d[5][3] = v1;
-            runsize++;
-        }
-
-        cpos = line_end;
-        while (cpos != cend && *cpos == ' ')
-            cpos++;
-        if (cpos != cend && *cpos == '\n')
-            cpos++;
+    m_text_glyph.clear();
+    int nlines = m_font_metrics.layout(m_text_glyph, halign, width, str, len);
+    std::size_t count = m_text_glyph.size();
+    if (!count)
+        return;
 
-        ypos++;
+    // One pass over the placed glyphs, with no per-character branches.
+    const Glyph *glyphs = m_font_metrics.glyphs();
+    const GlyphPos *gpos = m_text_glyph.data();
+    auto d = m_text_array.insert(count * 6);
+    for (std::size_t i = 0; i < count; i++, d += 6) {
+        const Glyph &g = glyphs[gpos[i].glyph];
+        short x0 = gpos[i].x, x1 = x0 + g.width;
+        short y1 = gpos[i].y, y0 = y1 - g.height;
+        short u0 = g.x, u1 = u0 + g.width, v1 = g.y, v0 = v1 + g.height;
+        d[0][0] = x0; d[0][1] = y0; d[0][2] = u0; d[0][3] = v0;
+        d[1][0] = x1; d[1][1] = y0; d[1][2] = u1; d[1][3] = v0;
+        d[2][0] = x0; d[2][1] = y1; d[2][2] = u0; d[2][3] = v1;
+        d[3][0] = x0; d[3][1] = y1; d[3][2] = u0; d[3][3] = v1;
+        d[4][0] = x1; d[4][1] = y0; d[4][2] = u1; d[4][3] = v0;
+        d[5][0] = x1; d[5][1] = y1; d[5][2] = u1; d[5][3] = v1;
     }
 
-    if (!runsize)
-        return;
-
     TextRun run;
     run.color = color;
     run.pos = pos;
@@ -492,13 +687,13 @@ void System::Data::text_put(IVec pos, HAlign halign, VAlign valign, int width,
     case VAlign::TOP:
         break;
     case VAlign::CENTER:
-        run.pos.y += (csz.y * ypos) / 2;
+        run.pos.y += (m_font_metrics.line_height() * nlines) / 2;
         break;
     case VAlign::BOTTOM:
-        run.pos.y += csz.y * ypos;
+        run.pos.y += m_font_metrics.line_height() * nlines;
         break;
     }
-    run.length = runsize;
+    run.length = static_cast<unsigned>(count);
     m_text_run.push_back(run);
 }
 
@@ -506,12 +701,13 @@ void System::Data::text_finalize() {
     m_text_array.upload(GL_DYNAMIC_DRAW);
 }
 
-void System::Data::text_draw() {
+void System::Data::text_draw(const float *xform) {
     auto &prog = m_prog_text;
     auto &arr = m_text_array;
 
     if (arr.empty())
         return;
+    ProfileScope scope("text_draw");
 
     glUseProgram(prog.prog());
     glEnableVertexAttribArray(prog->a_vert);
@@ -523,8 +719,8 @@ void System::Data::text_draw() {
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, m_font.tex);
 
-    glUniform4fv(prog->u_vertxform, 1, m_xform_screen);
-    glUniform2f(prog->u_texscale, 1.0f/16.0f, 1.0f/16.0f);
+    glUniform4fv(prog->u_vertxform, 1, xform);
+    glUniform2fv(prog->u_texscale, 1, m_font.scale);
     glUniform1i(prog->u_texture, 0);
 
     unsigned pos = 0;
@@ -553,21 +749,230 @@ void System::Data::text_draw() {
 
 // ============================================================
 
-void System::Data::draw_layers() {
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+void System::Data::particle_set(const Frame &frame) {
+    int mult = m_instanced ? 1 : 6;
+    m_particle_array.clear();
+    m_particle_count = 0;
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        auto &runs = m_particle_run[i];
+        runs.clear();
+        for (auto &cmd : frame.particles(static_cast<Layer>(i))) {
+            if (!cmd.count)
+                continue;
+            const ParticleVert *src = frame.particle_data(cmd);
+            unsigned count = static_cast<unsigned>(cmd.count);
+            ParticleRun run = { cmd.type, m_particle_count, count };
+            runs.push_back(run);
+            m_particle_count += count;
+            short (*data)[4] = m_particle_array.insert(count * mult);
+            if (m_instanced) {
+                std::memcpy(data, src, sizeof(*src) * count);
+                continue;
+            }
+            for (unsigned j = 0; j < count; j++) {
+                for (int k = 0; k < 6; k++) {
+                    data[j * 6 + k][0] = src[j].x;
+                    data[j * 6 + k][1] = src[j].y;
+                    data[j * 6 + k][2] = src[j].alpha;
+                    data[j * 6 + k][3] = src[j].size;
+                }
+            }
+        }
+    }
+}
+
+void System::Data::particle_finalize() {
+    static const short CORNER[6][2] = {
+        { 0, 0 }, { 1, 0 }, { 0, 1 }, { 0, 1 }, { 1, 0 }, { 1, 1 }
+    };
+    m_particle_array.upload(GL_STREAM_DRAW);
+    unsigned quads = m_instanced ? 1 : m_particle_count;
+    if (m_particle_corner.size() < quads * 6) {
+        quads = sg_round_up_pow2_32(quads);
+        m_particle_corner.clear();
+        short (*data)[2] = m_particle_corner.insert(quads * 6);
+        for (unsigned i = 0; i < quads * 6; i++) {
+            data[i][0] = CORNER[i % 6][0];
+            data[i][1] = CORNER[i % 6][1];
+        }
+        m_particle_corner.upload(GL_STATIC_DRAW);
+    }
+}
+
+void System::Data::particle_draw(Layer layer, const float *xform) {
+    auto &prog = m_prog_particle;
+    auto &runs = m_particle_run[static_cast<int>(layer)];
+
+    if (runs.empty())
+        return;
+    ProfileScope scope("particle_draw");
+
+    glUseProgram(prog.prog());
+    glEnableVertexAttribArray(prog->a_corner);
+    glEnableVertexAttribArray(prog->a_particle);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    glUniform4fv(prog->u_vertxform, 1, xform);
+    m_particle_corner.set_attrib(prog->a_corner);
+    if (m_instanced)
+        glVertexAttribDivisor(prog->a_particle, 1);
+    else
+        m_particle_array.set_attrib(prog->a_particle);
+
+    for (auto &run : runs) {
+        const ParticleStyle &style =
+            PARTICLE_STYLE[static_cast<int>(run.type)];
+        Color color = Color::palette(style.palette);
+        if (style.additive)
+            color.v[3] = 0.0f;
+        glUniform4fv(prog->u_color, 1, color.v);
+        if (m_instanced) {
+            // Without a base instance, offset the attribute instead.
+            m_particle_array.set_attrib(prog->a_particle, run.first);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, run.count);
+        } else {
+            glDrawArrays(GL_TRIANGLES, run.first * 6, run.count * 6);
+        }
+    }
+
+    // Other programs do not use these attributes.
+    if (m_instanced)
+        glVertexAttribDivisor(prog->a_particle, 0);
+    glDisableVertexAttribArray(prog->a_corner);
+    glDisableVertexAttribArray(prog->a_particle);
+    glUseProgram(0);
+    sg_opengl_checkerror("System::Data::particle_draw");
+}
+
+// ============================================================
+
+void System::Data::set_frame(const Frame &prev, const Frame &cur,
+                             float frac) {
+    if (cur.tile_key() != m_tile_key) {
+        sprite_clear(true);
+        for (auto &cmd : cur.sprites(Layer::TILE))
+            sprite_add(cmd.sprite, cmd.pos, cmd.orientation, cmd.z,
+                       Layer::TILE);
+        m_tile_key = cur.tile_key();
+    } else {
+        sprite_clear(false);
+    }
+
+    // Sprites are interpolated when both frames contain the same
+    // sprites in the same order, otherwise the current frame is used.
+    static const Layer LAYERS[] = {
+        Layer::PHYSICAL, Layer::DREAM, Layer::BOTH, Layer::INTERFACE
+    };
+    for (Layer layer : LAYERS) {
+        auto &c = cur.sprites(layer), &p = prev.sprites(layer);
+        bool match = &prev != &cur && p.size() == c.size();
+        for (std::size_t i = 0; i < c.size(); i++) {
+            IVec pos = c[i].pos;
+            if (match && p[i].sprite == c[i].sprite &&
+                p[i].orientation == c[i].orientation)
+                pos = lerp(p[i].pos, pos, frac);
+            sprite_add(c[i].sprite, pos, c[i].orientation, c[i].z, layer);
+        }
+    }
+
+    particle_set(cur);
+
+    text_clear();
+    for (auto &cmd : cur.text()) {
+        text_put(cmd.pos, cmd.halign, cmd.valign, cmd.width, cmd.color,
+                 cur.text_chars(cmd), cmd.length);
+    }
+
+    m_view.clear();
+    auto &cv = cur.views(), &pv = prev.views();
+    for (std::size_t i = 0; i < cv.size(); i++) {
+        View view;
+        view.rect = cv[i].rect;
+        view.camera = cv[i].camera;
+        view.scale = cv[i].scale;
+        view.world = cv[i].world;
+        if (pv.size() == cv.size() && pv[i].scale == cv[i].scale) {
+            view.camera = lerp(pv[i].camera, view.camera, frac);
+            view.world = pv[i].world + (view.world - pv[i].world) * frac;
+        }
+        m_view.push_back(view);
+    }
+
+    m_camera = lerp(prev.camera(), cur.camera(), frac);
+    m_world = prev.world() + (cur.world() - prev.world()) * frac;
+    for (int i = 0; i < 4; i++) {
+        float a = prev.noise()[i], b = cur.noise()[i];
+        // Noise offsets wrap around, don't interpolate across the seam.
+        m_noiseoffset[i] = std::abs(b - a) < 0.5f ? a + (b - a) * frac : b;
+    }
+}
+
+void System::Data::add_overlay(const Frame &frame) {
+    for (auto &cmd : frame.sprites(Layer::INTERFACE)) {
+        sprite_add(cmd.sprite, cmd.pos, cmd.orientation, cmd.z,
+                   Layer::INTERFACE);
+    }
+    for (auto &cmd : frame.text()) {
+        text_put(cmd.pos, cmd.halign, cmd.valign, cmd.width, cmd.color,
+                 frame.text_chars(cmd), cmd.length);
+    }
+}
+
+// ============================================================
 
+void System::Data::frame_update() {
+    Shader::FrameBlock block;
+    std::memset(&block, 0, sizeof(block));
+    std::memcpy(block.u_blendcolor, m_blendcolor.v, sizeof(float) * 4);
+    std::memcpy(block.u_blendscale, m_blendscale, sizeof(float) * 4);
+    std::memcpy(block.u_noiseoffset, m_noiseoffset, sizeof(float) * 4);
+    std::memcpy(block.u_backgroundxform, m_bgxform, sizeof(float) * 4);
+    for (int i = 0; i < 2; i++) {
+        block.u_pixscale[i] = m_pixscale[i];
+        block.u_noisescale[i] = m_pixscale[i] * (
+            m_noise_quality ? 1.0f / static_cast<float>(NOISE_PERIOD) :
+            m_noise.scale[i]);
+        block.u_scale[i] = m_scale[i];
+    }
+    block.u_world = m_world;
+    m_frame_block.update(&block);
+}
+
+bool System::Data::can_merge() const {
+    // Only the pattern filter has a merged shader, and the sharp
+    // filter needs the composite's linear filtering.
+    return m_merge && !m_transition_target.tex && !m_transition_capture &&
+        m_scale_filter == ScaleFilter::PATTERN &&
+        m_sprite_array[static_cast<int>(Layer::DREAM)].empty() &&
+        m_sprite_array[static_cast<int>(Layer::BOTH)].empty() &&
+        m_particle_run[static_cast<int>(Layer::DREAM)].empty() &&
+        m_particle_run[static_cast<int>(Layer::BOTH)].empty() &&
+        m_view.empty();
+}
+
+void System::Data::draw_physical() {
+    GPUScope gpu(m_timer, "gpu: physical");
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     target_set(Target::PHYSICAL);
     glClear(GL_COLOR_BUFFER_BIT);
     sprite_draw(Layer::TILE);
     sprite_draw(Layer::PHYSICAL);
+}
 
-    target_set(Target::COMPOSITE);
-    glClear(GL_COLOR_BUFFER_BIT);
-    draw_reality();
-    sprite_draw(Layer::DREAM);
-    sprite_draw(Layer::BOTH);
-    sprite_draw(Layer::INTERFACE);
-    text_draw();
+void System::Data::draw_composite() {
+    {
+        GPUScope gpu(m_timer, "gpu: composite");
+        target_set(Target::COMPOSITE);
+        glClear(GL_COLOR_BUFFER_BIT);
+        draw_reality();
+        sprite_draw(Layer::DREAM);
+        sprite_draw(Layer::BOTH);
+        draw_views();
+        sprite_draw(Layer::INTERFACE);
+        text_draw(m_xform_screen);
+        draw_transition();
+    }
 
     glReadBuffer(GL_COLOR_ATTACHMENT0);
     sg_record_frame_end(
@@ -587,24 +992,17 @@ void System::Data::draw_reality() {
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, target_texture(Target::PHYSICAL));
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, m_noise.tex);
+    if (!m_noise_quality) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, m_noise.tex);
+    }
     glActiveTexture(GL_TEXTURE2);
     glBindTexture(GL_TEXTURE_2D, m_background.tex);
 
     glUniform1i(prog->u_reality, 0);
     glUniform1i(prog->u_noise, 1);
     glUniform1i(prog->u_background, 2);
-
-    glUniform1f(prog->u_world, m_world);
-    glUniform4fv(prog->u_color, 1, m_blendcolor.v);
-    glUniform4fv(prog->u_blendscale, 1, m_blendscale);
-    float noisescale[2];
-    for (int i = 0; i < 2; i++)
-        noisescale[i] = m_pixscale[i] * m_noise.scale[i];
-    glUniform2fv(prog->u_noisescale, 1, noisescale);
-    glUniform4fv(prog->u_noiseoffset, 1, m_noiseoffset);
-    glUniform4fv(prog->u_backgroundxform, 1, m_bgxform);
+    m_frame_block.apply(prog.prog());
 
     arr.set_attrib(prog->a_vert);
 
@@ -616,10 +1014,143 @@ void System::Data::draw_reality() {
     sprite_draw(Layer::INTERFACE);
 }
 
+void System::Data::draw_views() {
+    if (m_view.empty())
+        return;
+    ProfileScope scope("draw_views");
+    Color clear = Color::palette(1);
+    glClearColor(clear.v[0], clear.v[1], clear.v[2], 1.0f);
+    glEnable(GL_SCISSOR_TEST);
+    for (auto &view : m_view) {
+        const IRect &r = view.viewport;
+        glViewport(r.x0, r.y0, r.width(), r.height());
+        glScissor(r.x0, r.y0, r.width(), r.height());
+        glClear(GL_COLOR_BUFFER_BIT);
+        sprite_draw(Layer::TILE, view.xform, view.world);
+        if (view.world < 1.0f)
+            sprite_draw(Layer::PHYSICAL, view.xform, view.world);
+        if (view.world > 0.0f)
+            sprite_draw(Layer::DREAM, view.xform, view.world);
+        sprite_draw(Layer::BOTH, view.xform, view.world);
+    }
+    glDisable(GL_SCISSOR_TEST);
+    glViewport(0, 0, m_target_width, m_target_height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+void System::Data::draw_transition() {
+    auto &prog = m_prog_transition;
+    auto &arr = m_array_composite;
+
+    if (!m_transition_target.tex)
+        return;
+
+    glUseProgram(prog.prog());
+    glEnableVertexAttribArray(prog->a_vert);
+    glDisable(GL_BLEND);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_transition_target.tex);
+    glUniform1i(prog->u_picture, 0);
+    // The wipe is centered on the visible area, and finishes when it
+    // reaches the corners.
+    glUniform2fv(prog->u_center, 1, m_blendscale);
+    glUniform1f(prog->u_time, m_transition);
+    glUniform1f(prog->u_maxradius,
+                0.5f * static_cast<float>(m_target_rect.width() +
+                                          m_target_rect.height()) + 1.0f);
+    m_frame_block.apply(prog.prog());
+
+    arr.set_attrib(prog->a_vert);
+    glDrawArrays(GL_TRIANGLES, 0, arr.size());
+
+    glUseProgram(0);
+    sg_opengl_checkerror("System::Data::draw_transition");
+}
+
+void System::Data::transition_capture() {
+    auto &composite = m_target[static_cast<int>(Target::COMPOSITE)];
+    transition_end();
+    m_transition_target = composite;
+    composite = m_target_pool.acquire(
+        m_target_width, m_target_height, GL_RGBA);
+    m_composite_filter = GL_NEAREST;
+    m_transition_capture = false;
+    m_transition = 0.0f;
+}
+
+void System::Data::transition_end() {
+    m_target_pool.release(m_transition_target);
+    std::memset(&m_transition_target, 0, sizeof(m_transition_target));
+}
+
 void System::Data::draw_scaled() {
-    auto &prog = m_prog_scale;
+    ScaleFilter filter = m_scale_filter;
+    if (filter == ScaleFilter::SHARP && m_scale_integer)
+        filter = ScaleFilter::NEAREST;
+
+    GPUScope gpu(m_timer, SCALE_FILTER_GPU_NAME[static_cast<int>(filter)]);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, m_width, m_height);
+    glDisable(GL_BLEND);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, target_texture(Target::COMPOSITE));
+    GLint texfilter = filter == ScaleFilter::SHARP ? GL_LINEAR : GL_NEAREST;
+    if (texfilter != m_composite_filter) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, texfilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texfilter);
+        m_composite_filter = texfilter;
+    }
+
+    GLint a_vert;
+    switch (filter) {
+    case ScaleFilter::NEAREST: {
+        auto &prog = m_prog_scale_nearest;
+        glUseProgram(prog.prog());
+        glUniform1i(prog->u_picture, 0);
+        a_vert = prog->a_vert;
+        break;
+    }
+
+    case ScaleFilter::SHARP: {
+        auto &prog = m_prog_scale_sharp;
+        glUseProgram(prog.prog());
+        glUniform1i(prog->u_picture, 0);
+        m_frame_block.apply(prog.prog());
+        a_vert = prog->a_vert;
+        break;
+    }
+
+    case ScaleFilter::PATTERN:
+    default: {
+        auto &prog = m_prog_scale;
+        glUseProgram(prog.prog());
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, m_pattern.tex);
+        glUniform1i(prog->u_picture, 0);
+        glUniform1i(prog->u_pattern, 1);
+        m_frame_block.apply(prog.prog());
+        a_vert = prog->a_vert;
+        break;
+    }
+    }
+
+    auto &arr = m_array_scale;
+    glEnableVertexAttribArray(a_vert);
+    arr.set_attrib(a_vert);
+
+    glDrawArrays(GL_TRIANGLES, 0, arr.size());
+
+    glUseProgram(0);
+    sg_opengl_checkerror("System::Data::draw_scaled");
+}
+
+void System::Data::draw_merged() {
+    auto &prog = m_prog_dream_scale;
     auto &arr = m_array_scale;
 
+    GPUScope gpu(m_timer, "gpu: merged");
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glViewport(0, 0, m_width, m_height);
 
@@ -628,20 +1159,34 @@ void System::Data::draw_scaled() {
     glDisable(GL_BLEND);
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, target_texture(Target::COMPOSITE));
-    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, target_texture(Target::PHYSICAL));
+    if (!m_noise_quality) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, m_noise.tex);
+    }
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, m_background.tex);
+    glActiveTexture(GL_TEXTURE3);
     glBindTexture(GL_TEXTURE_2D, m_pattern.tex);
 
-    glUniform1i(prog->u_picture, 0);
-    glUniform1i(prog->u_pattern, 1);
-    glUniform2fv(prog->u_pixscale, 1, m_pixscale);
+    glUniform1i(prog->u_reality, 0);
+    glUniform1i(prog->u_noise, 1);
+    glUniform1i(prog->u_background, 2);
+    glUniform1i(prog->u_pattern, 3);
+    m_frame_block.apply(prog.prog());
 
     arr.set_attrib(prog->a_vert);
-
     glDrawArrays(GL_TRIANGLES, 0, arr.size());
-
     glUseProgram(0);
-    sg_opengl_checkerror("System::Data::draw_scaled");
+
+    // The interface is drawn at window resolution, without the pattern.
+    sprite_draw(Layer::INTERFACE, m_xform_window, m_world);
+    particle_draw(Layer::INTERFACE, m_xform_window);
+    text_draw(m_xform_window);
+
+    glReadBuffer(GL_BACK);
+    sg_record_frame_end(0, 0, m_width, m_height);
+    sg_opengl_checkerror("System::Data::draw_merged");
 }
 
 void System::Data::draw() {
@@ -659,59 +1204,78 @@ System::System()
 System::~System()
 { }
 
-void System::clear(bool all) {
-    auto &d = *m_data;
-    d.sprite_clear(all);
-    d.text_clear();
+void System::set_frame(const Frame &frame) {
+    m_data->set_frame(frame, frame, 1.0f);
+}
+
+void System::set_frame(const Frame &prev, const Frame &cur, float frac) {
+    m_data->set_frame(prev, cur, frac);
+}
+
+void System::add_overlay(const Frame &frame) {
+    m_data->add_overlay(frame);
 }
 
 void System::finalize() {
+    ProfileScope scope("System::finalize");
     auto &d = *m_data;
     d.target_finalize();
+    d.frame_update();
     d.sprite_finalize();
+    d.particle_finalize();
     d.text_finalize();
 }
 
 void System::draw() {
     auto &d = *m_data;
-    d.draw_layers();
-    d.draw_scaled();
-}
-
-void System::set_size(int width, int height) {
-    auto &d = *m_data;
-    d.m_width = width;
-    d.m_height = height;
+    d.draw_physical();
+    if (d.can_merge()) {
+        d.draw_merged();
+    } else {
+        d.draw_composite();
+        d.draw_scaled();
+        if (d.m_transition_capture)
+            d.transition_capture();
+    }
+    d.m_timer.end_frame();
 }
 
-void System::set_camera(IVec pos) {
-    auto &d = *m_data;
-    d.m_camera = pos;
+void System::capture_transition() {
+    m_data->m_transition_capture = true;
 }
 
-void System::set_world(float world) {
+void System::set_transition(float progress) {
     auto &d = *m_data;
-    d.m_world = world;
+    if (progress >= 1.0f) {
+        d.transition_end();
+        d.m_transition = 0.0f;
+    } else {
+        d.m_transition = progress;
+    }
 }
 
-void System::set_noise(float noise[4]) {
+void System::reload_shader(const std::string &name) {
     auto &d = *m_data;
-    for (int i = 0; i < 4; i++)
-        d.m_noiseoffset[i] = noise[i];
-}
-
-void System::add_sprite(AnySprite sp, IVec pos, Layer layer,
-                        Orientation orientation) {
-    m_data->sprite_add(sp, pos, orientation, layer);
+    reload_program(d.m_prog_sprite, name);
+    reload_program(d.m_prog_dream, name);
+    reload_program(d.m_prog_scale, name);
+    reload_program(d.m_prog_scale_nearest, name);
+    reload_program(d.m_prog_scale_sharp, name);
+    reload_program(d.m_prog_dream_scale, name);
+    reload_program(d.m_prog_transition, name);
+    reload_program(d.m_prog_text, name);
+    reload_program(d.m_prog_particle, name);
 }
 
-void System::add_sprite(AnySprite sp, IVec pos, Layer layer) {
-    m_data->sprite_add(sp, pos, Orientation::NORMAL, layer);
+IRect System::visible_rect(int width, int height) {
+    return IRect(-TARGET_MARGIN, -TARGET_MARGIN,
+                 width / 2 + TARGET_MARGIN, height / 2 + TARGET_MARGIN);
 }
 
-void System::put_text(IVec pos, HAlign halign, VAlign valign, int width,
-                      Color color, const std::string &str) {
-    m_data->text_put(pos, halign, valign, width, color, str);
+void System::set_size(int width, int height) {
+    auto &d = *m_data;
+    d.m_width = width;
+    d.m_height = height;
 }
 
 }
@@ -3,19 +3,11 @@
    of the 2-clause BSD license.  For more information, see LICENSE.txt. */
 #ifndef LD_GRAPHICS_SYSTEM_HPP
 #define LD_GRAPHICS_SYSTEM_HPP
+#include "base/vec.hpp"
 #include <memory>
 #include <string>
-namespace Base {
-enum class Orientation;
-struct IVec;
-}
 namespace Graphics {
-enum class Layer;
-class AnySprite;
-struct Color;
-
-enum class HAlign { LEFT, CENTER, RIGHT };
-enum class VAlign { BOTTOM, CENTER, TOP };
+class Frame;
 
 class System {
 private:
@@ -30,31 +22,33 @@ public:
     System &operator=(const System &) = delete;
     System &operator=(System &&) = delete;
 
-    /// Clear graphics state.
-    void clear(bool all);
+    /// Build the graphics state from a recorded frame.
+    void set_frame(const Frame &frame);
+    /// Build the graphics state by interpolating between two
+    /// successive frames.  The fraction is in the range [0,1].
+    void set_frame(const Frame &prev, const Frame &cur, float frac);
+    /// Add the interface sprites and text from a frame on top of the
+    /// current graphics state.  Used for debugging overlays.
+    void add_overlay(const Frame &frame);
     /// Finalize changes to the graphics state.
     void finalize();
     /// Draw the world.
     void draw();
+    /// Keep the next frame drawn as the picture for a transition.  The
+    /// picture is shown until the transition starts.
+    void capture_transition();
+    /// Set the transition progress, from 0 to 1.  At 1, the
+    /// transition ends and the captured picture is released.
+    void set_transition(float progress);
+    /// Recompile all shader programs which use the named shader.
+    void reload_shader(const std::string &name);
 
     /// Set the render size.
     void set_size(int width, int height);
-    /// Set the lower-left corner of the camera.
-    void set_camera(Base::IVec pos);
-    /// Set the current world, or in between.
-    void set_world(float world);
-    /// Set the noise offsets.
-    void set_noise(float noise[4]);
-    /// Add a sprite to the world.
-    void add_sprite(AnySprite sp, Base::IVec pos, Layer layer,
-                    Base::Orientation orientation);
-    /// Add a sprite to the world.
-    void add_sprite(AnySprite sp, Base::IVec pos, Layer layer);
-    /// Put text on the screen.  Width is measured in pixels, use -1
-    /// for unlimited width.  The point specified is on the edge of
-    /// the text's bounding box.
-    void put_text(Base::IVec pos, HAlign halign, VAlign valign, int width,
-                  Color color, const std::string &str);
+    /// Get the area of the world which can appear in a window of the
+    /// given size, relative to the camera.  This includes the margin
+    /// read by the dream distortion.
+    static Base::IRect visible_rect(int width, int height);
 };
 
 }
@@ -0,0 +1,96 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "target.hpp"
+#include "base/log.hpp"
+namespace Graphics {
+
+using Base::Log;
+
+namespace {
+
+// Maximum number of released targets to keep.  The oldest are deleted
+// first.
+const std::size_t MAX_FREE = 8;
+
+void destroy(const RenderTarget &target) {
+    glDeleteFramebuffers(1, &target.fbuf);
+    glDeleteTextures(1, &target.tex);
+}
+
+}
+
+TargetPool::TargetPool()
+{ }
+
+TargetPool::~TargetPool() {
+    for (auto &target : m_free)
+        destroy(target);
+}
+
+RenderTarget TargetPool::acquire(int width, int height, GLenum format) {
+    for (auto i = m_free.begin(), e = m_free.end(); i != e; ++i) {
+        if (i->width == width && i->height == height &&
+            i->format == format) {
+            RenderTarget target = *i;
+            m_free.erase(i);
+            // The previous user may have changed the filter.
+            glBindTexture(GL_TEXTURE_2D, target.tex);
+            glTexParameteri(
+                GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(
+                GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            return target;
+        }
+    }
+
+    RenderTarget target;
+    target.width = width;
+    target.height = height;
+    target.format = format;
+    glGenTextures(1, &target.tex);
+    glGenFramebuffers(1, &target.fbuf);
+
+    glBindTexture(GL_TEXTURE_2D, target.tex);
+    glTexImage2D(
+        GL_TEXTURE_2D,
+        0,
+        format,
+        width,
+        height,
+        0,
+        GL_RGBA,
+        GL_UNSIGNED_BYTE,
+        nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbuf);
+    glFramebufferTexture2D(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+        target.tex, 0);
+    GLenum draw_buffers[1] = { GL_COLOR_ATTACHMENT0 };
+    glDrawBuffers(1, draw_buffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+        GL_FRAMEBUFFER_COMPLETE)
+        Log::abort("cannot render to framebuffer");
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    Log::debug("created %dx%d render target", width, height);
+    sg_opengl_checkerror("TargetPool::acquire");
+    return target;
+}
+
+void TargetPool::release(const RenderTarget &target) {
+    if (!target.tex)
+        return;
+    if (m_free.size() >= MAX_FREE) {
+        destroy(m_free.front());
+        m_free.erase(m_free.begin());
+    }
+    m_free.push_back(target);
+}
+
+}
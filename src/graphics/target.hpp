@@ -0,0 +1,43 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_GRAPHICS_TARGET_HPP
+#define LD_GRAPHICS_TARGET_HPP
+#include "sg/opengl.h"
+#include <vector>
+namespace Graphics {
+
+/// An offscreen render target: a texture attached to a framebuffer.
+struct RenderTarget {
+    GLuint tex;
+    GLuint fbuf;
+    int width;
+    int height;
+    GLenum format;
+};
+
+/// A pool of render targets, keyed by size and format.  Released
+/// targets are kept for reuse, so resizing the window back and forth
+/// does not reallocate them.
+class TargetPool {
+private:
+    // Released targets, least recently released first.
+    std::vector<RenderTarget> m_free;
+
+public:
+    TargetPool();
+    TargetPool(const TargetPool &) = delete;
+    ~TargetPool();
+    TargetPool &operator=(const TargetPool &) = delete;
+
+    /// Get a render target with the given size and internal format,
+    /// reusing a released target if possible.  The target always
+    /// uses nearest filtering.
+    RenderTarget acquire(int width, int height, GLenum format);
+    /// Return a render target to the pool.  Does nothing if the
+    /// target was never created.
+    void release(const RenderTarget &target);
+};
+
+}
+#endif
@@ -0,0 +1,77 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#include "timer.hpp"
+#include "base/clock.hpp"
+#include "base/opengl.hpp"
+#include "base/profile.hpp"
+namespace Graphics {
+
+using Base::Profile;
+
+GPUTimer::GPUTimer()
+    : m_available(false), m_active(false), m_frame(0) {
+    for (int i = 0; i < LATENCY; i++) {
+        m_frames[i].count = 0;
+        for (int j = 0; j < MAX_PASS; j++)
+            m_frames[i].query[j] = 0;
+    }
+}
+
+GPUTimer::~GPUTimer() {
+    if (m_available) {
+        for (int i = 0; i < LATENCY; i++)
+            glDeleteQueries(MAX_PASS, m_frames[i].query);
+    }
+}
+
+void GPUTimer::begin(const char *name) {
+    if (!Profile::enabled())
+        return;
+    if (!m_available) {
+        // Queries are created lazily, so the OpenGL context exists.
+        if (!Base::GLInfo::version(3, 3) &&
+            !Base::GLInfo::extension("GL_ARB_timer_query"))
+            return;
+        for (int i = 0; i < LATENCY; i++)
+            glGenQueries(MAX_PASS, m_frames[i].query);
+        m_available = true;
+    }
+    Frame &f = m_frames[m_frame];
+    if (f.count >= MAX_PASS)
+        return;
+    f.pass[f.count].name = name;
+    f.pass[f.count].start = Base::Clock::micros();
+    glBeginQuery(GL_TIME_ELAPSED, f.query[f.count]);
+    m_active = true;
+}
+
+void GPUTimer::end() {
+    if (!m_active)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    m_frames[m_frame].count++;
+    m_active = false;
+}
+
+void GPUTimer::end_frame() {
+    if (!m_available)
+        return;
+    m_frame = (m_frame + 1) % LATENCY;
+    // The oldest frame should be finished by now.  If not, the
+    // results are discarded rather than stalling the pipeline.
+    Frame &f = m_frames[m_frame];
+    for (int i = 0; i < f.count; i++) {
+        GLint ready = 0;
+        glGetQueryObjectiv(f.query[i], GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready)
+            break;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(f.query[i], GL_QUERY_RESULT, &ns);
+        Profile::record_gpu(f.pass[i].name, f.pass[i].start,
+                            static_cast<long long>(ns / 1000));
+    }
+    f.count = 0;
+}
+
+}
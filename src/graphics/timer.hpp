@@ -0,0 +1,60 @@
+/* Copyright 2014 Dietrich Epp.
+   This file is part of Dreamless.  Dreamless is licensed under the terms
+   of the 2-clause BSD license.  For more information, see LICENSE.txt. */
+#ifndef LD_GRAPHICS_TIMER_HPP
+#define LD_GRAPHICS_TIMER_HPP
+#include "sg/opengl.h"
+namespace Graphics {
+
+/// Measures the GPU time of rendering passes with timer queries, and
+/// reports them to the profiler.  Results are read back a few frames
+/// later so the CPU never waits for the GPU.  Passes cannot nest.
+class GPUTimer {
+private:
+    static const int LATENCY = 3;
+    static const int MAX_PASS = 8;
+
+    struct Pass {
+        const char *name;
+        long long start;
+    };
+
+    struct Frame {
+        int count;
+        Pass pass[MAX_PASS];
+        GLuint query[MAX_PASS];
+    };
+
+    bool m_available;
+    bool m_active;
+    int m_frame;
+    Frame m_frames[LATENCY];
+
+public:
+    GPUTimer();
+    GPUTimer(const GPUTimer &) = delete;
+    ~GPUTimer();
+    GPUTimer &operator=(const GPUTimer &) = delete;
+
+    /// Start timing a pass.  The name must be a string literal.
+    void begin(const char *name);
+    /// Stop timing the current pass.
+    void end();
+    /// Mark the end of a frame, and report finished results.
+    void end_frame();
+};
+
+/// Time a GPU pass for the duration of a scope.
+class GPUScope {
+    GPUTimer &m_timer;
+
+public:
+    GPUScope(GPUTimer &timer, const char *name)
+        : m_timer(timer) { m_timer.begin(name); }
+    GPUScope(const GPUScope &) = delete;
+    ~GPUScope() { m_timer.end(); }
+    GPUScope &operator=(const GPUScope &) = delete;
+};
+
+}
+#endif